@@ -4,9 +4,72 @@ if %errorlevel% == 2 (
     echo Error compiling shaders!
     exit
 )
-tcc ./src/main.c ./src/include/gl.c ./src/include/mt19937ar.c -Wall -o "tetris.exe" -lSDL2 -lbass -lSDL2main -Wl,-subsystem=windows
+rem Pass big, 4wide or tall to build one of the other board variants, see game.h
+set BOARD=
+set EXE=tetris.exe
+if "%1" == "big" (
+    set BOARD=-DBOARD_BIG
+    set EXE=tetris-big.exe
+)
+if "%1" == "4wide" (
+    set BOARD=-DBOARD_4WIDE
+    set EXE=tetris-4wide.exe
+)
+if "%1" == "tall" (
+    set BOARD=-DBOARD_TALL
+    set EXE=tetris-tall.exe
+)
+rem Pass debug, after the board variant if there is one, to build with the GAME_DEBUG self-checks
+set DEBUG=
+if "%1" == "debug" set DEBUG=-DGAME_DEBUG
+if "%2" == "debug" set DEBUG=-DGAME_DEBUG
+if not "%DEBUG%" == "" set EXE=%EXE:.exe=-debug.exe%
+set BOARD=%BOARD% %DEBUG%
+tcc -c ./src/game.c -Wall %BOARD% -o game.o && tcc -c ./src/replay.c -Wall %BOARD% -o replay.o && tcc -c ./src/mapping.c -Wall -o mapping.o && tcc -c ./src/journal.c -Wall %BOARD% -o journal.o && tcc -c ./src/include/mt19937ar.c -Wall -o mt19937ar.o && tcc -ar rcs libr97sim.a game.o replay.o mapping.o journal.o mt19937ar.o
+if not %errorlevel% == 0 (
+    echo Error compiling simulation library!
+    pause
+    exit
+)
+tcc ./src/tools/play.c -Wall %BOARD% -o play.exe -L. -lr97sim
+if not %errorlevel% == 0 (
+    echo Error compiling replay player!
+    pause
+    exit
+)
+tcc ./src/tools/bisect.c -Wall %BOARD% -o bisect.exe -L. -lr97sim
+if not %errorlevel% == 0 (
+    echo Error compiling replay bisector!
+    pause
+    exit
+)
+tcc ./src/tools/archive.c -Wall %BOARD% -o archive.exe -L. -lr97sim
+if not %errorlevel% == 0 (
+    echo Error compiling replay archive!
+    pause
+    exit
+)
+tcc ./src/tools/verify.c ./src/tools/batch.c -Wall %BOARD% -o verify.exe -L. -lr97sim -lSDL2
+if not %errorlevel% == 0 (
+    echo Error compiling replay verifier!
+    pause
+    exit
+)
+tcc ./src/tools/stats.c ./src/tools/batch.c -Wall %BOARD% -o stats.exe -L. -lr97sim -lSDL2
+if not %errorlevel% == 0 (
+    echo Error compiling replay statistics!
+    pause
+    exit
+)
+tcc ./src/tools/render.c ./src/tools/batch.c ./src/render.c -Wall %BOARD% -o render.exe -L. -lr97sim -lSDL2
+if not %errorlevel% == 0 (
+    echo Error compiling replay renderer!
+    pause
+    exit
+)
+tcc ./src/main.c ./src/render.c ./src/include/gl.c -Wall %BOARD% -o "%EXE%" -L. -lr97sim -lSDL2 -lbass -lSDL2main -Wl,-subsystem=windows
 if %errorlevel% == 0 (
-    .\tetris.exe
+    .\%EXE%
 ) else (
     echo Error compiling game!
     pause
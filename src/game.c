@@ -0,0 +1,1020 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef GAME_DEBUG
+#include <assert.h>
+#endif
+
+#include "game.h"
+
+#ifdef GAME_DEBUG
+unsigned int game_allocations = 0;
+unsigned long game_allocation_count = 0;
+
+// The real functions are called through parentheses, which keeps the counting macros of `game.h` from expanding.
+void *game_malloc(size_t size)
+{
+    void *ptr = (malloc)(size);
+    if (ptr != NULL)
+    {
+        game_allocations++;
+        game_allocation_count++;
+    }
+    return ptr;
+}
+
+void *game_calloc(size_t count, size_t size)
+{
+    void *ptr = (calloc)(count, size);
+    if (ptr != NULL)
+    {
+        game_allocations++;
+        game_allocation_count++;
+    }
+    return ptr;
+}
+
+// Growing or shrinking a block counts as an allocation too, it may move it
+void *game_realloc(void *ptr, size_t size)
+{
+    void *moved = (realloc)(ptr, size);
+    if (moved != NULL)
+    {
+        game_allocations += ptr == NULL;
+        game_allocation_count++;
+    }
+    return moved;
+}
+
+void game_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    assert(game_allocations > 0);
+    game_allocations--;
+    (free)(ptr);
+}
+#endif
+
+static void push_event(GameState *game, GameEventType type, unsigned int data)
+{
+    if (game->event_count < MAX_EVENTS)
+        game->events[game->event_count++] = (GameEvent){type, data};
+}
+
+// Piece randomizer from Tetris: The Grand Master, returns 15 random bits.
+static unsigned int game_random(GameState *game)
+{
+    game->randomizer.rng = game->randomizer.rng * 0x41C64E6D + 12345;
+    return (game->randomizer.rng >> 10) & 0x7FFF;
+}
+
+// Returns `true` only on the first frame an input is held, like `key_is_pressed` does for keys.
+static bool input_pressed(GameState *game, unsigned int bit)
+{
+    if ((game->input & bit) && !(game->pressed & bit))
+    {
+        game->pressed |= bit;
+        return true;
+    }
+    return false;
+}
+
+// Zobrist keys of the parts of `game_hash`, made up on the spot by scrambling what they stand for.
+// Empty rows and queue slots have no key so an empty board hashes to zero.
+static uint64_t zobrist_key(uint64_t feature)
+{
+    feature += 0x9E3779B97F4A7C15;
+    feature = (feature ^ (feature >> 30)) * 0xBF58476D1CE4E5B9;
+    feature = (feature ^ (feature >> 27)) * 0x94D049BB133111EB;
+    return feature ^ (feature >> 31);
+}
+
+static uint64_t row_key(int y, uint16_t row)
+{
+    return row == ROW_EMPTY ? 0 : zobrist_key(1ull << 40 | (uint64_t)y << 16 | row);
+}
+
+static uint64_t queue_key(int slot, unsigned int type)
+{
+    return type == PIECE_NONE ? 0 : zobrist_key(2ull << 40 | slot << 8 | type);
+}
+
+static uint64_t piece_key(Piece *piece)
+{
+    return zobrist_key(3ull << 40 | piece->locked << 28 | piece->type << 24 | piece->rotation << 16 |
+                       (unsigned char)piece->x << 8 | (unsigned char)piece->y);
+}
+
+// The randomizers other than the default one deal from more than the RNG, their kind and state go in as well.
+// Like an empty board, the state the default randomizer leaves untouched has no key.
+static uint64_t randomizer_key(GameState *game)
+{
+    RandomizerState *randomizer = &game->randomizer;
+    uint32_t history, pool_low, pool_high = 0;
+    memcpy(&history, randomizer->history, sizeof(history));
+    memcpy(&pool_low, randomizer->pool, sizeof(pool_low));
+    memcpy(&pool_high, randomizer->pool + 4, sizeof(randomizer->pool) - 4);
+    uint64_t key = zobrist_key(4ull << 40 | randomizer->rng);
+    if (game->rules.randomizer != RANDOMIZER_PREVIEW)
+        key ^= zobrist_key(5ull << 40 | game->rules.randomizer);
+    if (history != 0)
+        key ^= zobrist_key(6ull << 40 | history);
+    if (pool_low != 0 || pool_high != 0)
+        key ^= zobrist_key(7ull << 40 | pool_low) ^ zobrist_key(8ull << 40 | pool_high);
+    if (randomizer->order != 0)
+        key ^= zobrist_key(9ull << 40 | randomizer->order);
+    return key;
+}
+
+uint64_t game_hash(GameState *game)
+{
+    return game->hash ^ piece_key(&game->piece) ^ randomizer_key(game);
+}
+
+#ifdef GAME_DEBUG
+// Asserts that the incremental hash matches hashing the board and queue from scratch.
+static void check_hash(GameState *game)
+{
+    uint64_t hash = 0;
+    for (int y = 0; y < BOARD_HEIGHT; y++)
+        hash ^= row_key(y, ROW(game, y));
+    for (int i = 0; i < QUEUE_SIZE; i++)
+        hash ^= queue_key(i, game->queue[i]);
+    assert(game->hash == hash);
+}
+#endif
+
+// History every TGM randomizer starts with, so the first pieces are unlikely to be S, Z or O.
+static const unsigned char RANDOMIZER_HISTORIES[RANDOMIZER_AMOUNT][RANDOMIZER_HISTORY] = {
+    [RANDOMIZER_TGM1] = {PIECE_Z, PIECE_Z, PIECE_Z, PIECE_Z},
+    [RANDOMIZER_TGM2] = {PIECE_Z, PIECE_S, PIECE_S, PIECE_Z},
+    [RANDOMIZER_TGM3] = {PIECE_S, PIECE_Z, PIECE_S, PIECE_Z},
+};
+#define TGM3_POOL_COPIES 5 // of every piece in the pool of 35
+// Types that were never dealt count as dealt before all others, the lowest first.
+#define TGM3_ORDER_START (0 | 1 << 3 | 2 << 6 | 3 << 9 | 4 << 12 | 5 << 15 | 6 << 18)
+
+_Static_assert(QUEUE_SIZE < PIECE_TYPES, "the preview randomizer needs a piece that isn't in the queue left to deal");
+
+// Piece `index` of a pool holding `pool[type]` pieces of every type, counting through the types in order.
+static PieceIndex pool_piece(const unsigned char *pool, unsigned int index)
+{
+    for (int type = 0; type < PIECE_TYPES - 1; type++)
+    {
+        if (index < pool[type])
+            return type + PIECE_I;
+        index -= pool[type];
+    }
+    return PIECE_T;
+}
+
+static bool in_history(RandomizerState *randomizer, PieceIndex piece)
+{
+    for (int i = 0; i < RANDOMIZER_HISTORY; i++)
+    {
+        if (randomizer->history[i] == piece)
+            return true;
+    }
+    return false;
+}
+
+static void push_history(RandomizerState *randomizer, PieceIndex piece)
+{
+    memmove(randomizer->history, randomizer->history + 1, RANDOMIZER_HISTORY - 1);
+    randomizer->history[RANDOMIZER_HISTORY - 1] = piece;
+}
+
+// The history stays empty until a TGM randomizer deals its first piece, which then starts it.
+static bool first_deal(RandomizerState *randomizer)
+{
+    return randomizer->history[RANDOMIZER_HISTORY - 1] == PIECE_NONE;
+}
+
+// The TGM randomizers never start with a piece that can't be laid flat on an empty board.
+static PieceIndex deal_first(GameState *game)
+{
+    static const PieceIndex FIRST_PIECES[] = {PIECE_I, PIECE_J, PIECE_L, PIECE_T};
+    memcpy(game->randomizer.history, RANDOMIZER_HISTORIES[game->rules.randomizer], RANDOMIZER_HISTORY);
+    return FIRST_PIECES[game_random(game) % 4];
+}
+
+// Picks among the pieces that aren't in the queue, so no piece shows up twice in it.
+static PieceIndex deal_preview(GameState *game)
+{
+    unsigned char pool[PIECE_TYPES];
+    memset(pool, 1, sizeof(pool));
+    for (int i = 0; i < QUEUE_SIZE; i++)
+    {
+        if (game->queue[i] != PIECE_NONE)
+            pool[game->queue[i] - PIECE_I] = 0;
+    }
+    unsigned int left = 0;
+    for (int type = 0; type < PIECE_TYPES; type++)
+        left += pool[type];
+    return pool_piece(pool, game_random(game) % left);
+}
+
+// Rolls up to `rolls` times for a piece that isn't in the history, keeping the last roll if they all were.
+static PieceIndex deal_history(GameState *game, int rolls)
+{
+    RandomizerState *randomizer = &game->randomizer;
+    PieceIndex piece = first_deal(randomizer) ? deal_first(game) : PIECE_NONE;
+    for (int i = 0; piece == PIECE_NONE || (i < rolls && in_history(randomizer, piece)); i++)
+        piece = game_random(game) % PIECE_TYPES + PIECE_I;
+    push_history(randomizer, piece);
+    return piece;
+}
+
+static PieceIndex deal_tgm1(GameState *game)
+{
+    return deal_history(game, 4);
+}
+
+static PieceIndex deal_tgm2(GameState *game)
+{
+    return deal_history(game, 6);
+}
+
+static PieceIndex most_droughted(RandomizerState *randomizer)
+{
+    return (randomizer->order & 7) + PIECE_I;
+}
+
+// Move a type to the newest end of `order`.
+static void order_dealt(RandomizerState *randomizer, PieceIndex piece)
+{
+    unsigned int type = piece - PIECE_I;
+    int shift = 0;
+    while (((randomizer->order >> shift) & 7) != type)
+        shift += 3;
+    uint32_t older = randomizer->order & ((1u << shift) - 1);
+    uint32_t newer = randomizer->order >> (shift + 3);
+    randomizer->order = older | newer << shift | type << 3 * (PIECE_TYPES - 1);
+}
+
+/*
+	Rolls up to 6 times against the history like TGM2, but draws from a pool of 35 pieces instead of all 7 types.
+	Every piece drawn or rolled over in the pool is replaced by the one that went the longest without being dealt,
+	so droughts fix themselves. Only the amount of every type in the pool is kept, which draws them as often as
+	the original 35 slots do, and the order the types were last dealt in rather than how long ago each was.
+*/
+static PieceIndex deal_tgm3(GameState *game)
+{
+    RandomizerState *randomizer = &game->randomizer;
+    PieceIndex piece;
+    bool drawn = !first_deal(randomizer); // from the pool, the first piece isn't
+    if (!drawn)
+        piece = deal_first(game);
+    else
+    {
+        for (int i = 0;; i++)
+        {
+            piece = pool_piece(randomizer->pool, game_random(game) % (PIECE_TYPES * TGM3_POOL_COPIES));
+            if (i == 5 || !in_history(randomizer, piece))
+                break;
+            randomizer->pool[piece - PIECE_I]--;
+            randomizer->pool[most_droughted(randomizer) - PIECE_I]++;
+        }
+        randomizer->pool[piece - PIECE_I]--;
+    }
+
+    order_dealt(randomizer, piece);
+    if (drawn)
+        randomizer->pool[most_droughted(randomizer) - PIECE_I]++;
+    push_history(randomizer, piece);
+    return piece;
+}
+
+// Deals the pieces left in the bag in a random order and fills it up again once it's empty.
+static PieceIndex deal_bag(GameState *game)
+{
+    RandomizerState *randomizer = &game->randomizer;
+    unsigned int left = 0;
+    for (int type = 0; type < PIECE_TYPES; type++)
+        left += randomizer->pool[type];
+    if (left == 0)
+    {
+        memset(randomizer->pool, 1, sizeof(randomizer->pool));
+        left = PIECE_TYPES;
+    }
+    PieceIndex piece = pool_piece(randomizer->pool, game_random(game) % left);
+    randomizer->pool[piece - PIECE_I]--;
+    return piece;
+}
+
+static PieceIndex (*const RANDOMIZERS[RANDOMIZER_AMOUNT])(GameState *game) = {
+    [RANDOMIZER_PREVIEW] = deal_preview,
+    [RANDOMIZER_TGM1] = deal_tgm1,
+    [RANDOMIZER_TGM2] = deal_tgm2,
+    [RANDOMIZER_TGM3] = deal_tgm3,
+    [RANDOMIZER_BAG] = deal_bag,
+};
+
+void init_queue(GameState *game)
+{
+    RandomizerState *randomizer = &game->randomizer;
+    if (game->rules.randomizer == RANDOMIZER_TGM3)
+    {
+        memset(randomizer->pool, TGM3_POOL_COPIES, sizeof(randomizer->pool));
+        randomizer->order = TGM3_ORDER_START;
+    }
+    for (int i = 0; i < QUEUE_SIZE; i++)
+    {
+        PieceIndex piece = deal_piece(game);
+        game->hash ^= queue_key(i, game->queue[i]) ^ queue_key(i, piece);
+        game->queue[i] = piece;
+    }
+}
+
+PieceIndex deal_piece(GameState *game)
+{
+    return RANDOMIZERS[game->rules.randomizer](game);
+}
+
+void update_queue(GameState *game, PieceIndex piece)
+{
+    for (int i = 0; i < QUEUE_SIZE; i++)
+    {
+        unsigned int next = i + 1 < QUEUE_SIZE ? game->queue[i + 1] : piece;
+        game->hash ^= queue_key(i, game->queue[i]) ^ queue_key(i, next);
+    }
+    memmove(game->queue, game->queue + 1, QUEUE_SIZE - 1);
+    game->queue[QUEUE_SIZE - 1] = piece;
+}
+
+void init_game_state(GameState *game, GameRules rules)
+{
+#ifdef GAME_DEBUG
+    unsigned long allocations = game_allocation_count;
+#endif
+    memset(game, 0, sizeof(GameState));
+    game->rules = rules;
+    game->seed = rules.seed;
+    game->randomizer.rng = rules.seed;
+    for (int y = -BOARD_CEILING; y < BOARD_HEIGHT + BOARD_FLOOR; y++)
+        ROW(game, y) = y >= 0 && y < BOARD_HEIGHT ? ROW_EMPTY : ROW_FULL;
+
+    init_queue(game);
+
+    game->piece = new_piece(game, -1);
+    game->game_over = false;
+    game->ticks = 0;
+    game->gravity = level_gravity(0);
+    game->tpu = 1;
+    game->level = 0;
+    game->score = 0;
+    memcpy(game->delays, TIMER_DELAYS, sizeof(game->delays));
+    memset(game->timer_slots, TIMER_NONE, sizeof(game->timer_slots));
+#ifdef GAME_DEBUG
+    assert(game_allocation_count == allocations);
+#endif
+}
+
+GameState *new_game_state(GameRules rules)
+{
+    GameState *game = malloc(sizeof(GameState));
+    init_game_state(game, rules);
+    return game;
+}
+
+void free_game_state(GameState *game)
+{
+    free(game);
+}
+
+// Puts a timer in the wheel slot of the tick it is due.
+static void link_timer(GameState *game, GameTimer timer, unsigned int due)
+{
+    unsigned char *slot = &game->timer_slots[due % TIMER_SLOTS];
+    game->timer_due[timer] = due;
+    game->timer_next[timer] = *slot;
+    *slot = timer;
+    game->timers |= 1u << timer;
+}
+
+_Static_assert(sizeof(GameSnapshot) <= SNAPSHOT_MAX_SIZE, "snapshots should stay small enough to copy thousands of times per frame");
+
+void save_game(GameState *game, GameSnapshot *snapshot)
+{
+    snapshot->ticks = game->ticks;
+    snapshot->hash = game->hash;
+    snapshot->randomizer = game->randomizer;
+    snapshot->level = game->level;
+    snapshot->score = game->score;
+    snapshot->gravity = game->gravity;
+    memcpy(snapshot->rows, &ROW(game, 0), sizeof(snapshot->rows));
+    snapshot->piece = game->piece;
+    memcpy(snapshot->queue, game->queue, sizeof(snapshot->queue));
+    snapshot->fall = game->fall;
+    snapshot->input = game->input;
+    snapshot->pressed = game->pressed;
+    snapshot->shifting = game->shifting;
+    snapshot->game_over = game->game_over;
+    snapshot->clear_y1 = game->clear_y1;
+    snapshot->clear_y2 = game->clear_y2;
+    snapshot->timers = game->timers;
+    for (int t = 0; t < TIMER_AMOUNT; t++)
+        snapshot->timer_left[t] = timer_armed(game, t) ? game->timer_due[t] - (unsigned int)game->ticks : 0;
+}
+
+void restore_game(GameState *game, const GameSnapshot *snapshot)
+{
+    game->ticks = snapshot->ticks;
+    game->hash = snapshot->hash;
+    game->randomizer = snapshot->randomizer;
+    game->level = snapshot->level;
+    game->score = snapshot->score;
+    game->gravity = snapshot->gravity;
+    memcpy(&ROW(game, 0), snapshot->rows, sizeof(snapshot->rows));
+    for (int x = 0; x < BOARD_WIDTH; x++)
+    {
+        int y = 0;
+        while (y < BOARD_HEIGHT && !(ROW(game, y) & CELL_BIT(x)))
+            y++;
+        game->heights[x] = BOARD_HEIGHT - y;
+    }
+    game->piece = snapshot->piece;
+    memcpy(game->queue, snapshot->queue, sizeof(snapshot->queue));
+    game->fall = snapshot->fall;
+    game->input = snapshot->input;
+    game->pressed = snapshot->pressed;
+    game->shifting = snapshot->shifting;
+    game->game_over = snapshot->game_over;
+    game->clear_y1 = snapshot->clear_y1;
+    game->clear_y2 = snapshot->clear_y2;
+    game->event_count = 0;
+#ifdef GAME_DEBUG
+    // Snapshots only hold the row masks, the cells start over from them
+    for (int y = 0; y < BOARD_HEIGHT; y++)
+        for (int x = 0; x < BOARD_WIDTH; x++)
+            game->cells[y][x] = (ROW(game, y) & CELL_BIT(x)) != 0;
+#endif
+
+    // The wheel is rebuilt from the frames every timer had left
+    game->timers = 0;
+    memset(game->timer_slots, TIMER_NONE, sizeof(game->timer_slots));
+    for (int t = 0; t < TIMER_AMOUNT; t++)
+    {
+        if (!(snapshot->timers & (1u << t)))
+            continue;
+        link_timer(game, t, (unsigned int)game->ticks + snapshot->timer_left[t]);
+    }
+}
+
+bool every_n_frames(GameState *game, unsigned int frames)
+{
+    return game->ticks % frames == 0;
+}
+
+void arm_timer(GameState *game, GameTimer timer)
+{
+    cancel_timer(game, timer);
+    unsigned int delay = game->delays[timer] > 0 ? game->delays[timer] : 1;
+    link_timer(game, timer, (unsigned int)game->ticks + delay);
+}
+
+void cancel_timer(GameState *game, GameTimer timer)
+{
+    if (!timer_armed(game, timer))
+        return;
+    unsigned char *link = &game->timer_slots[game->timer_due[timer] % TIMER_SLOTS];
+    while (*link != timer)
+        link = &game->timer_next[*link];
+    *link = game->timer_next[timer];
+    game->timers &= ~(1u << timer);
+}
+
+bool timer_armed(GameState *game, GameTimer timer)
+{
+    return (game->timers & (1u << timer)) != 0;
+}
+
+static void on_das(GameState *game)
+{
+    game->shifting = true;
+}
+
+static void on_lock_delay(GameState *game)
+{
+    if (!game->piece.locked && game->piece.coll)
+        lock_piece(game, &game->piece);
+}
+
+static void on_line_clear(GameState *game)
+{
+    clear_lines(game, game->clear_y1, game->clear_y2);
+    arm_timer(game, TIMER_ARE);
+}
+
+static void on_are(GameState *game)
+{
+    if (game->game_over)
+        return;
+    game->gravity = level_gravity(game->level);
+    game->fall = 0;
+    game->piece = new_piece(game, -1);
+    if (game->gravity >= GRAVITY_20G)
+        drop_piece(game, &game->piece, BOARD_HEIGHT);
+}
+
+// What happens when every timer fires, timers without a handler only mark a span of frames.
+static void (*const TIMER_HANDLERS[TIMER_AMOUNT])(GameState *game) = {
+    [TIMER_DAS] = on_das,
+    [TIMER_LOCK] = on_lock_delay,
+    [TIMER_LINE_CLEAR] = on_line_clear,
+    [TIMER_ARE] = on_are,
+    [TIMER_LOCK_FLASH] = NULL,
+};
+
+#ifdef GAME_DEBUG
+// Every armed timer has to be linked once, in the wheel slot of the tick it is due.
+static void check_timers(GameState *game)
+{
+    unsigned int linked = 0;
+    for (unsigned int s = 0; s < TIMER_SLOTS; s++)
+    {
+        for (unsigned char timer = game->timer_slots[s]; timer != TIMER_NONE; timer = game->timer_next[timer])
+        {
+            assert(game->timer_due[timer] % TIMER_SLOTS == s);
+            assert(!(linked & (1u << timer)));
+            linked |= 1u << timer;
+        }
+    }
+    assert(linked == game->timers);
+}
+#endif
+
+// Fires the timers due this frame. Only the wheel slot of the current tick is walked.
+static void fire_timers(GameState *game)
+{
+    unsigned int due = 0;
+    unsigned char *link = &game->timer_slots[game->ticks % TIMER_SLOTS];
+    while (*link != TIMER_NONE)
+    {
+        unsigned char timer = *link;
+        if (game->timer_due[timer] != (unsigned int)game->ticks)
+        {
+            link = &game->timer_next[timer];
+            continue;
+        }
+        *link = game->timer_next[timer];
+        game->timers &= ~(1u << timer);
+        due |= 1u << timer;
+    }
+
+    // Handlers may arm timers again, so they only run once the slot is done
+    for (GameTimer timer = 0; due != 0; timer++, due >>= 1)
+    {
+        if ((due & 1) && TIMER_HANDLERS[timer] != NULL)
+            TIMER_HANDLERS[timer](game);
+    }
+}
+
+unsigned int level_gravity(unsigned int level)
+{
+    unsigned int i = 1;
+    while (i < GRAVITY_STEPS && GRAVITY_CURVE[i][0] <= level)
+        i++;
+    return GRAVITY_CURVE[i - 1][1];
+}
+
+Piece new_piece(GameState *game, int idx)
+{
+    Piece p = {0};
+    PieceIndex index = idx;
+    int initial_dir = 0;
+
+    if (index == -1)
+    {
+        update_queue(game, deal_piece(game));
+        index = game->queue[0];
+        if (game->input & INPUT_CCW)
+            initial_dir = -1;
+        else if (game->input & INPUT_CW)
+            initial_dir = 1;
+    }
+
+    p.type = index;
+    if (index == PIECE_NONE)
+        return p;
+    p.rotation = ROT_0;
+    p.x = ROTATION_SYSTEMS[game->rules.rotation].spawn[index - 1][0] + BOARD_SPAWN_SHIFT;
+    p.y = ROTATION_SYSTEMS[game->rules.rotation].spawn[index - 1][1];
+
+    if (idx == -1)
+    {
+        if (initial_dir != 0)
+            push_event(game, EVENT_IRS, initial_dir);
+
+        push_event(game, EVENT_PIECE_SPAWN, game->queue[1]);
+    }
+
+    return p;
+}
+
+const uint16_t *piece_mask(GameState *game, PieceIndex type, Rotation rotation)
+{
+    return ROTATION_SYSTEMS[game->rules.rotation].masks[type - 1][rotation];
+}
+
+int piece_range(GameState *game, Piece *piece, PieceRange range)
+{
+    const uint16_t *mask = piece_mask(game, piece->type, piece->rotation);
+    int a = 0;
+    int b = 3;
+    while (mask[a] == 0)
+        a++;
+    while (mask[b] == 0)
+        b--;
+
+    switch (range)
+    {
+    case HIGHEST_BLOCK:
+        return piece->y + a;
+    case LOWEST_BLOCK:
+        return piece->y + b;
+    case FULL_RANGE:
+    default:
+        return a - b;
+    }
+}
+
+#ifdef GAME_DEBUG
+// Cell by cell version of `piece_collides`, kept to cross-check the shifted row masks against.
+static bool board_collides(GameState *game, PieceIndex type, Rotation rotation, int x, int y)
+{
+    for (int by = 0; by < 4; by++)
+        for (int bx = 0; bx < 4; bx++)
+        {
+            if (!(piece_mask(game, type, rotation)[by] & (1 << bx)))
+                continue;
+            int cx = x + bx;
+            int cy = y + by;
+            if (cx < 0 || cx >= BOARD_WIDTH || cy < 0 || cy >= BOARD_HEIGHT)
+                return true;
+            if (game->cells[cy][cx])
+                return true;
+        }
+    return false;
+}
+
+// Cell by cell version of locking a piece.
+static void lock_cells(GameState *game, Piece *piece)
+{
+    for (int by = 0; by < 4; by++)
+        for (int bx = 0; bx < 4; bx++)
+        {
+            int cy = piece->y + by;
+            if ((piece_mask(game, piece->type, piece->rotation)[by] & (1 << bx)) && cy >= 0 && cy < BOARD_HEIGHT)
+                game->cells[cy][piece->x + bx] = true;
+        }
+}
+
+// Cell by cell version of `clear_lines`, every full row is taken out on its own and everything above it moves down a row.
+static void clear_cells(GameState *game, int y1, int y2)
+{
+    for (int y = y1; y <= y2; y++)
+    {
+        bool full = true;
+        for (int x = 0; x < BOARD_WIDTH; x++)
+            full &= game->cells[y][x];
+        if (!full)
+            continue;
+        for (int above = y; above > 0; above--)
+            memcpy(game->cells[above], game->cells[above - 1], sizeof(game->cells[above]));
+        memset(game->cells[0], false, sizeof(game->cells[0]));
+    }
+}
+
+// Asserts that the row masks match the cells, that the walls, ceiling and floor around the rows are intact
+// and that the column heights match them.
+static void check_board(GameState *game)
+{
+    for (int y = 0; y < BOARD_HEIGHT; y++)
+    {
+        uint16_t row = ROW_EMPTY;
+        for (int x = 0; x < BOARD_WIDTH; x++)
+        {
+            if (game->cells[y][x])
+                row |= CELL_BIT(x);
+        }
+        assert(ROW(game, y) == row);
+    }
+    for (int y = 1; y <= BOARD_CEILING; y++)
+        assert(ROW(game, -y) == ROW_FULL);
+    for (int y = BOARD_HEIGHT; y < BOARD_HEIGHT + BOARD_FLOOR; y++)
+        assert(ROW(game, y) == ROW_FULL);
+    for (int x = 0; x < BOARD_WIDTH; x++)
+    {
+        int y = 0;
+        while (y < BOARD_HEIGHT && !(ROW(game, y) & CELL_BIT(x)))
+            y++;
+        assert(game->heights[x] == BOARD_HEIGHT - y);
+    }
+}
+#endif
+
+bool piece_collides(GameState *game, PieceIndex type, Rotation rotation, int x, int y)
+{
+    const uint16_t *mask = piece_mask(game, type, rotation);
+    const uint16_t *rows = &ROW(game, y);
+    int shift = x + BOARD_WALL;
+    bool hit = ((rows[0] & (mask[0] << shift)) |
+                (rows[1] & (mask[1] << shift)) |
+                (rows[2] & (mask[2] << shift)) |
+                (rows[3] & (mask[3] << shift))) != 0;
+#ifdef GAME_DEBUG
+    assert(hit == board_collides(game, type, rotation, x, y));
+#endif
+    return hit;
+}
+
+int drop_distance(GameState *game, Piece *piece)
+{
+    const signed char *bottom = ROTATION_SYSTEMS[game->rules.rotation].bottom[piece->type - 1][piece->rotation];
+    int distance = BOARD_HEIGHT;
+    for (int c = 0; c < 4; c++)
+    {
+        if (bottom[c] < 0)
+            continue;
+        int d = BOARD_HEIGHT - game->heights[piece->x + c] - 1 - (piece->y + bottom[c]);
+        if (d < 0)
+        {
+            // The piece is under an overhang, so the column heights can't tell where it lands
+            distance = 0;
+            while (!piece_collides(game, piece->type, piece->rotation, piece->x, piece->y + distance + 1))
+                distance++;
+            return distance;
+        }
+        if (d < distance)
+            distance = d;
+    }
+    return distance;
+}
+
+void drop_piece(GameState *game, Piece *piece, int cells)
+{
+    int distance = drop_distance(game, piece);
+    move_piece(game, piece, 0, cells < distance ? cells : distance);
+}
+
+void move_piece(GameState *game, Piece *piece, int x, int y)
+{
+    if (piece_collides(game, piece->type, piece->rotation, piece->x + x, piece->y + y))
+    {
+        // Falling into something skips the lock delay
+        if (x == 0)
+        {
+            push_event(game, EVENT_PIECE_COLLIDE, 0);
+            lock_piece(game, piece);
+        }
+        return;
+    }
+
+    piece->x += x;
+    piece->y += y;
+
+    bool grounded = piece_collides(game, piece->type, piece->rotation, piece->x, piece->y + 1);
+    if (grounded && !piece->coll)
+    {
+        piece->coll = true;
+        push_event(game, EVENT_PIECE_COLLIDE, 0);
+        arm_timer(game, TIMER_LOCK);
+    }
+    if (!grounded && piece->coll)
+    {
+        piece->coll = false;
+        cancel_timer(game, TIMER_LOCK);
+    }
+}
+
+// Mihara's conspiracy: reading the box row by row, a rotation first blocked by a cell
+// in its center column isn't allowed to kick.
+static bool center_column_blocked(GameState *game, const uint16_t *mask, int x, int y)
+{
+    int shift = x + BOARD_WALL;
+    for (int r = 0; r < 3; r++)
+    {
+        unsigned int hits = ROW(game, y + r) & (mask[r] << shift);
+        if (hits != 0)
+            return (hits & -hits) == 1u << (shift + 1);
+    }
+    return false;
+}
+
+void rotate_piece(GameState *game, Piece *piece, int direction)
+{
+    const RotationSystem *rs = &ROTATION_SYSTEMS[game->rules.rotation];
+    Rotation r = (piece->rotation + direction) & ROT_270;
+    const uint16_t *mask = rs->masks[piece->type - 1][r];
+    int i = piece->type == PIECE_I;
+    const signed char (*kicks)[2] = rs->kicks[i][piece->rotation][direction < 0];
+
+    for (int n = 0; n < rs->kick_tests[i]; n++)
+    {
+        int x = piece->x + kicks[n][0];
+        int y = piece->y + kicks[n][1];
+        if (!piece_collides(game, piece->type, r, x, y))
+        {
+            piece->rotation = r;
+            piece->x = x;
+            piece->y = y;
+            return;
+        }
+        if (n == 0 && (rs->center_column & (1 << piece->type)) && center_column_blocked(game, mask, x, y))
+            return;
+    }
+}
+
+void lock_piece(GameState *game, Piece *piece)
+{
+    piece->locked = true;
+    const uint16_t *mask = piece_mask(game, piece->type, piece->rotation);
+    for (int by = 0; by < 4; by++)
+    {
+        if (mask[by] == 0)
+            continue;
+        int py = piece->y + by;
+        uint16_t row = ROW(game, py) | mask[by] << (piece->x + BOARD_WALL);
+        if (py >= 0 && py < BOARD_HEIGHT)
+            game->hash ^= row_key(py, ROW(game, py)) ^ row_key(py, row);
+        ROW(game, py) = row;
+        for (int bx = 0; bx < 4; bx++)
+        {
+            if (!(mask[by] & (1 << bx)))
+                continue;
+            int px = piece->x + bx;
+            game->board[py * BOARD_WIDTH + px] = piece->type;
+            if (game->heights[px] < BOARD_HEIGHT - py)
+                game->heights[px] = BOARD_HEIGHT - py;
+        }
+    }
+#ifdef GAME_DEBUG
+    lock_cells(game, piece);
+#endif
+    push_event(game, EVENT_PIECE_LOCK, 0);
+    cancel_timer(game, TIMER_LOCK);
+    arm_timer(game, TIMER_LOCK_FLASH);
+    game->clear_y1 = piece_range(game, piece, HIGHEST_BLOCK);
+    game->clear_y2 = piece_range(game, piece, LOWEST_BLOCK);
+
+#ifdef GAME_DEBUG
+    check_board(game);
+#endif
+
+    if (game->clear_y1 <= 0)
+    {
+        game->game_over = true;
+        push_event(game, EVENT_GAME_OVER, 0);
+    }
+
+    // Full lines stay on the board for the line clear delay before the next piece's ARE starts
+    bool lines = false;
+    for (int y = game->clear_y1 > 1 ? game->clear_y1 : 1; y <= game->clear_y2; y++)
+        lines |= ROW(game, y) == ROW_FULL;
+    arm_timer(game, lines ? TIMER_LINE_CLEAR : TIMER_ARE);
+
+    game->level++;
+}
+
+int clear_lines(GameState *game, int y1, int y2)
+{
+    // Row 0 is only ever filled by topping out, and the floor under the board is always full
+    if (y1 <= 0)
+        y1 = 1;
+    if (y2 >= BOARD_HEIGHT)
+        y2 = BOARD_HEIGHT - 1;
+#ifdef GAME_DEBUG
+    clear_cells(game, y1, y2);
+#endif
+
+    // Collect the full lines first so every row above them only moves once
+    int cleared[BOARD_HEIGHT];
+    int count = 0;
+    for (int y = y1; y <= y2; y++)
+    {
+        if (ROW(game, y) != ROW_FULL)
+            continue;
+        cleared[count++] = y;
+        push_event(game, EVENT_LINE_CLEAR, y);
+        game->score += 100 + game->level * 2;
+        game->level++;
+    }
+    if (count == 0)
+        return 0;
+
+    // Every row down to the lowest cleared line changes, their keys go out now and back in once they moved
+    for (int y = 0; y <= cleared[count - 1]; y++)
+        game->hash ^= row_key(y, ROW(game, y));
+
+    // Rows between two cleared lines move down by the number of lines cleared under them
+    int dst = cleared[count - 1];
+    for (int i = count - 1; i > 0; i--)
+    {
+        for (int src = cleared[i] - 1; src > cleared[i - 1]; src--, dst--)
+        {
+            ROW(game, dst) = ROW(game, src);
+            memcpy(&game->board[dst * BOARD_WIDTH], &game->board[src * BOARD_WIDTH], BOARD_WIDTH);
+        }
+    }
+
+    // Everything above the highest cleared line moves down as a single block
+    int top = cleared[0];
+    memmove(&ROW(game, count), &ROW(game, 0), top * sizeof(uint16_t));
+    memmove(&game->board[count * BOARD_WIDTH], &game->board[0], top * BOARD_WIDTH);
+    for (int y = 0; y < count; y++)
+        ROW(game, y) = ROW_EMPTY;
+    memset(&game->board[0], PIECE_NONE, count * BOARD_WIDTH);
+
+    for (int y = 0; y <= cleared[count - 1]; y++)
+        game->hash ^= row_key(y, ROW(game, y));
+
+    // Columns that had blocks above the highest cleared line just sink with them,
+    // the rest had their top on that line and have to look for their new one
+    for (int x = 0; x < BOARD_WIDTH; x++)
+    {
+        if (game->heights[x] > BOARD_HEIGHT - top)
+        {
+            game->heights[x] -= count;
+            continue;
+        }
+        int y = top + count;
+        while (y < BOARD_HEIGHT && !(ROW(game, y) & CELL_BIT(x)))
+            y++;
+        game->heights[x] = BOARD_HEIGHT - y;
+    }
+#ifdef GAME_DEBUG
+    check_board(game);
+#endif
+
+    return count;
+}
+
+void step_game(GameState *game, unsigned int input)
+{
+#ifdef GAME_DEBUG
+    unsigned long allocations = game_allocation_count;
+#endif
+    game->ticks++;
+    game->event_count = 0;
+    game->input = input;
+    game->pressed &= input;
+
+    fire_timers(game);
+
+    // A new press moves once and charges DAS, the direction repeats once `TIMER_DAS` fires
+    int input_h = (int)((input & INPUT_RIGHT) != 0) - (int)((input & INPUT_LEFT) != 0);
+    bool shift = false;
+    if (input_h == 0)
+    {
+        game->shifting = false;
+        cancel_timer(game, TIMER_DAS);
+    }
+    else if (input_pressed(game, INPUT_LEFT) | input_pressed(game, INPUT_RIGHT))
+    {
+        game->shifting = false;
+        arm_timer(game, TIMER_DAS);
+        shift = true;
+    }
+
+    if (!game->piece.locked)
+    {
+        if (!(input & INPUT_DOWN) && (shift || game->shifting))
+            move_piece(game, &game->piece, input_h, 0);
+        if (input_pressed(game, INPUT_CCW))
+            rotate_piece(game, &game->piece, -1);
+        if (input_pressed(game, INPUT_CW))
+            rotate_piece(game, &game->piece, 1);
+        if (input_pressed(game, INPUT_HARD))
+        {
+            drop_piece(game, &game->piece, BOARD_HEIGHT);
+            lock_piece(game, &game->piece);
+        }
+        else if (input_pressed(game, INPUT_SONIC))
+            drop_piece(game, &game->piece, BOARD_HEIGHT);
+
+        if (!game->piece.locked && (input & INPUT_DOWN) && every_n_frames(game, game->tpu))
+        {
+            if (!game->piece.coll)
+                drop_piece(game, &game->piece, 1);
+            else
+                lock_piece(game, &game->piece);
+        }
+        else if (!game->piece.locked && !game->piece.coll)
+        {
+            // Whole rows fallen this frame are dropped in one go, the rest carries over to the next one
+            game->fall += game->gravity;
+            if (game->fall >= 256)
+            {
+                drop_piece(game, &game->piece, game->fall >> 8);
+                game->fall &= 0xFF;
+            }
+        }
+    }
+
+#ifdef GAME_DEBUG
+    check_timers(game);
+    check_hash(game);
+    assert(game_allocation_count == allocations);
+#endif
+}
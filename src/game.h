@@ -1,11 +1,68 @@
 #ifndef GAME_HEADER 
 #define GAME_HEADER
 
+// The game rules, kept apart from Tangram so they can be simulated without a window or audio device.
+
+#include <stdbool.h>
+#include <stdint.h>
+
 #define QUEUE_SIZE 5
+// Bump whenever a change to the rules makes the same inputs play out differently, so states saved by an older
+// engine, like the keyframes of a replay or the session journal, aren't restored into this one.
+#define ENGINE_VERSION 1
+
+/*
+	Board geometry is fixed at compile time so every loop over it has constant bounds.
+	Build with one of these defined to get another variant of the game:
+
+	BOARD_BIG:   Big mode from TGM, blocks twice as large. It plays exactly like a 5x10 board
+	BOARD_4WIDE: 4 columns
+	BOARD_TALL:  twice the rows of the standard board
+
+	Every variant also sets the most bytes a `GameSnapshot` of its board may take, `SNAPSHOT_MAX_SIZE`.
+*/
+#if defined(BOARD_BIG)
+#define BOARD_WIDTH 5
+#define BOARD_HEIGHT 10
+#define CELL_SIZE 32
+#define SNAPSHOT_MAX_SIZE 96
+#elif defined(BOARD_4WIDE)
+#define BOARD_WIDTH 4
+#define BOARD_HEIGHT 20
+#define CELL_SIZE 16
+#define SNAPSHOT_MAX_SIZE 120
+#elif defined(BOARD_TALL)
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 40
+#define CELL_SIZE 11
+#define SNAPSHOT_MAX_SIZE 160
+#else
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 20
+#define CELL_SIZE 16
+#define SNAPSHOT_MAX_SIZE 120
+#endif
+
+// Every row of the board is mirrored as a bitmask where column `x` is bit `x + BOARD_WALL`.
+// The bits left and right of the board are always set so they act as walls,
+// and `BOARD_CEILING` and `BOARD_FLOOR` full rows are kept above and under the board.
+#define BOARD_WALL 3
+#define BOARD_CEILING 4
+#define BOARD_FLOOR 4
+#define ROW_FULL ((uint16_t)0xFFFF)
+#define ROW_EMPTY ((uint16_t)~(((1 << BOARD_WIDTH) - 1) << BOARD_WALL))
+#define CELL_BIT(x) ((uint16_t)(1 << ((x) + BOARD_WALL)))
+#if BOARD_WIDTH + 2 * BOARD_WALL > 16
+#error "Rows are 16-bit masks, boards can't be wider than 10 columns"
+#endif
+
+// Row `y` of the board in `GameState.rows`, rows above and under the board can be indexed too.
+// Rows are reached by index rather than through a pointer so a game can be copied around freely.
+#define ROW(game, y) ((game)->rows[BOARD_CEILING + (y)])
+
+// Columns the spawn positions of the rotation systems, made for 10 columns, move by to stay centered.
+#define BOARD_SPAWN_SHIFT ((BOARD_WIDTH - 10) / 2)
 
-static const unsigned char BOARD_WIDTH = 10;
-static const unsigned char BOARD_HEIGHT = 20;
-static const unsigned char CELL_SIZE = 16;
 static const unsigned int PIECE_COLORS[8] = {
 	0x999999, // Empty/placeholder piece
 	0x5FF4EA,
@@ -17,141 +74,6 @@ static const unsigned int PIECE_COLORS[8] = {
 	0xE450F4,
 };
 
-static const unsigned char ROTATION_DATA[7][4][4][2] = {
-	{
-		// I
-		/*
-		{{1, 2}, {2, 2}, {3, 2}, {4, 2}},
-		{{2, 1}, {2, 2}, {2, 3}, {2, 4}},
-		{{0, 2}, {1, 2}, {2, 2}, {3, 2}},
-		{{2, 3}, {2, 2}, {2, 1}, {2, 0}},
-		*/
-		{{0, 1}, {1, 1}, {2, 1}, {3, 1}},
-		{{2, 0}, {2, 1}, {2, 2}, {2, 3}},
-		{{0, 1}, {1, 1}, {2, 1}, {3, 1}},
-		{{2, 0}, {2, 1}, {2, 2}, {2, 3}},
-	},
-	{
-		// J️
-		{{0, 0}, {0, 1}, {1, 1}, {2, 1}},
-		{{2, 0}, {1, 0}, {1, 1}, {1, 2}},
-		{{2, 2}, {2, 1}, {1, 1}, {0, 1}},
-		{{0, 2}, {1, 2}, {1, 1}, {1, 0}},
-	},
-	{
-		// L️
-		{{2, 0}, {2, 1}, {1, 1}, {0, 1}},
-		{{2, 2}, {1, 2}, {1, 1}, {1, 0}},
-		{{0, 2}, {0, 1}, {1, 1}, {2, 1}},
-		{{0, 0}, {1, 0}, {1, 1}, {1, 2}},
-	},
-	{
-		// O️
-		{{1, 0}, {2, 0}, {1, 1}, {2, 1}},
-		{{1, 1}, {2, 1}, {1, 2}, {2, 2}},
-		{{0, 1}, {1, 1}, {0, 2}, {1, 2}},
-		{{0, 0}, {1, 0}, {0, 1}, {1, 1}},
-	},
-	{
-		// S
-		{{1, 0}, {2, 0}, {0, 1}, {1, 1}},
-		{{2, 1}, {2, 2}, {1, 0}, {1, 1}},
-		{{1, 2}, {0, 2}, {2, 1}, {1, 1}},
-		{{0, 1}, {0, 0}, {1, 2}, {1, 1}},
-	},
-	{
-		// Z
-		{{0, 0}, {1, 0}, {1, 1}, {2, 1}},
-		{{2, 0}, {2, 1}, {1, 1}, {1, 2}},
-		{{2, 2}, {1, 2}, {1, 1}, {0, 1}},
-		{{0, 2}, {0, 1}, {1, 1}, {1, 0}},
-	},
-	{
-		// T️
-		{{0, 1}, {1, 0}, {1, 1}, {2, 1}},
-		{{1, 0}, {2, 1}, {1, 1}, {1, 2}},
-		{{2, 1}, {1, 2}, {1, 1}, {0, 1}},
-		{{1, 2}, {0, 1}, {1, 1}, {1, 0}},
-	}
-};
-
-/*
-	Wall kick data indexing:
-
-	p = Piece type (2)
-	r = Rotation (4)
-	d = Direction (2)
-	n = Test number (5 - 1 since all first tets are 0, 0)
-	(x, y) (2)
-*/
-static const int WALLKICK_TESTS = 4;
-static const unsigned char WALLKICK_DATA[2][4][2][4][2] = {
-	// Non-I pieces
-	{
-		// Rotation 0
-		{
-			// Direction -1
-			{{1, 0}, {1, 1}, {0, -2}, {1, -2}},
-			// Direction 1
-			{{-1, 0}, {-1, 1}, {0, -2}, {-1, -2}},
-		},
-		// Rotation 1
-		{
-			// Direction -1
-			{{1, 0}, {1, -1}, {0, 2}, {1, 2}},
-			// Direction 1
-			{{1, 0}, {1, -1}, {0, 2}, {1, 2}},
-		},
-		// Rotation 2
-		{
-			// Direction -1
-			{{-1, 0}, {-1, 1}, {0, -2}, {-1, -2}},
-			// Direction 1
-			{{1, 0}, {1, 1}, {0, -2}, {1, -2}},
-		},
-		// Rotation 3
-		{
-			// Direction -1
-			{{-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
-			// Direction 1
-			{{-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
-		},
-	},
-	// I piece
-	{
-		// Rotation 0
-		{
-			// Direction -1
-			{{-1, 0}, {2, 0}, {-1, 2}, {2, -1}},
-			// Direction 1
-			{{-2, 0}, {1, 0}, {-2, -1}, {1, 2}},
-		},
-		// Rotation 1
-		{
-			// Direction -1
-			{{2, 0}, {-1, 0}, {2, 1}, {-1, -2}},
-			// Direction 1
-			{{-1, 0}, {2, 0}, {-1, 2}, {2, -1}},
-		},
-		// Rotation 2
-		{
-			// Direction -1
-			{{1, 0}, {-2, 0}, {1, -2}, {-2, -1}},
-			// Direction 1
-			{{2, 0}, {-1, 0}, {2, 1}, {-1, -2}},
-		},
-		// Rotation 3
-		{
-			// Direction -1
-			{{-2, 0}, {1, 0}, {-2, -1}, {1, 2}},
-			// Direction 1
-			{{1, 0}, {-2, 0}, {1, -2}, {-2, 1}},
-		},
-	}
-};
-
-unsigned char *board = NULL;
-
 enum PieceIndex
 {
 	PIECE_NONE,
@@ -165,15 +87,6 @@ enum PieceIndex
 };
 typedef enum PieceIndex PieceIndex;
 
-enum SoundIndex
-{
-	SOUND_PIECECOLLIDE,
-	SOUND_DISAPPEAR = 8,
-	SOUND_FALL = 9,
-	SOUND_PIECELOCK = 10,
-	SOUND_IRS = 11,
-};
-
 enum Rotation
 {
 	ROT_0,
@@ -183,21 +96,14 @@ enum Rotation
 };
 typedef enum Rotation Rotation;
 
-typedef struct Block
-{
-	unsigned short unused : 1;
-	unsigned short piece : 3;
-	unsigned short rotation : 2;
-	unsigned short y : 5;
-	unsigned short x : 5;
-} Block;
-
-// Create a new block.
-Block new_block(unsigned short data);
+#include "rotation.h"
 
 typedef struct Piece
 {
-	Block blocks[4];
+	unsigned char type; // `PieceIndex`
+	unsigned char rotation; // `Rotation`
+	signed char x; // column of the piece's 4x4 box, see `RotationSystem`
+	signed char y; // row of the piece's 4x4 box
 	bool coll;
 	bool locked;
 } Piece;
@@ -210,56 +116,296 @@ enum PieceRange
 };
 typedef enum PieceRange PieceRange;
 
-// Create a new tetromino from a piece index.
-// Passing index `-1` creates a random piece and adds it to the queue.
-Piece *new_piece(int idx);
-// Returns part of or the entire range of a piece in the Y axis.
-unsigned int piece_range(Piece *piece, PieceRange range);
-// Move a tetromino by an offset in x and/or y.
-void move_piece(Piece *piece, int x, int y);
-// Rotate a tetromino in a given direction, `1` is clockwise and `-1` counter-clockwise.
-void rotate_piece(Piece *piece, int direction);
-// Lock a tetromino by placing it on the play board then frees its memory.
-void lock_piece(Piece *piece);
-// Checks if a line has been cleared.
-void check_line(unsigned int y);
+// Buttons held during a frame, packed into the bits passed to `step_game`.
+enum GameInput
+{
+	INPUT_LEFT = 1 << 0,
+	INPUT_RIGHT = 1 << 1,
+	INPUT_DOWN = 1 << 2,
+	INPUT_CCW = 1 << 3,
+	INPUT_CW = 1 << 4,
+	INPUT_SONIC = 1 << 5, // drop the piece to the stack without locking it
+	INPUT_HARD = 1 << 6,  // drop the piece to the stack and lock it
+};
+typedef enum GameInput GameInput;
+
+// Things that happened during a frame which the engine may want to play a sound or an effect for.
+enum GameEventType
+{
+	EVENT_PIECE_SPAWN,   // `data` is the next piece in the queue
+	EVENT_IRS,
+	EVENT_PIECE_COLLIDE,
+	EVENT_PIECE_LOCK,
+	EVENT_LINE_CLEAR,    // `data` is the cleared row
+	EVENT_GAME_OVER,
+};
+typedef enum GameEventType GameEventType;
+
+typedef struct GameEvent
+{
+	GameEventType type;
+	unsigned int data;
+} GameEvent;
+
+#define MAX_EVENTS 16
 
 #define DAS_FRAMES 12
 #define ARE_FRAMES 30
 #define LOCK_DELAY 30
+#define LINE_CLEAR_FRAMES 41
+#define LOCK_FLASH_FRAMES 3
+
+/*
+	Frame timers of a game, see `arm_timer`.
+
+	Timers due on the same frame fire in the order they are listed here.
+*/
+enum GameTimer
+{
+	TIMER_DAS,        // the held direction starts repeating
+	TIMER_LOCK,       // a grounded piece locks
+	TIMER_LINE_CLEAR, // the cleared lines of the last lock are removed, then `TIMER_ARE` starts
+	TIMER_ARE,        // the next piece spawns
+	TIMER_LOCK_FLASH, // the last locked piece stops flashing
+	TIMER_AMOUNT
+};
+typedef enum GameTimer GameTimer;
+
+// Frames every timer runs for, new games copy them into `delays`.
+static const unsigned char TIMER_DELAYS[TIMER_AMOUNT] = {
+	[TIMER_DAS] = DAS_FRAMES,
+	[TIMER_LOCK] = LOCK_DELAY,
+	[TIMER_LINE_CLEAR] = LINE_CLEAR_FRAMES,
+	[TIMER_ARE] = ARE_FRAMES,
+	[TIMER_LOCK_FLASH] = LOCK_FLASH_FRAMES,
+};
+
+// Armed timers are kept in a wheel with a slot per frame, so a frame only looks at the timers in its own slot.
+// Timers further away than `TIMER_SLOTS` frames wait in their slot until the frame they are due.
+#define TIMER_SLOTS 16
+#define TIMER_NONE 0xFF
+
+/*
+	Gravity curve from Tetris: The Grand Master.
+
+	Every entry is the level it starts at and the gravity from then on in 1/256 G,
+	256 being one row per frame and `GRAVITY_20G` dropping pieces onto the stack instantly.
+*/
+#define GRAVITY_20G (20 * 256)
+static const unsigned int GRAVITY_CURVE[][2] = {
+	{0, 4},
+	{30, 6},
+	{35, 8},
+	{40, 10},
+	{50, 12},
+	{60, 16},
+	{70, 32},
+	{80, 48},
+	{90, 64},
+	{100, 80},
+	{120, 96},
+	{140, 112},
+	{160, 128},
+	{170, 144},
+	{200, 4},
+	{220, 32},
+	{230, 64},
+	{233, 96},
+	{236, 128},
+	{239, 160},
+	{243, 192},
+	{247, 224},
+	{251, 256},
+	{300, 512},
+	{330, 768},
+	{360, 1024},
+	{400, 1280},
+	{420, 1024},
+	{450, 768},
+	{500, GRAVITY_20G},
+};
+#define GRAVITY_STEPS (sizeof(GRAVITY_CURVE) / sizeof(GRAVITY_CURVE[0]))
+
+/*
+	Piece randomizers a game can be dealt its pieces by. Their whole state lives in the game and every piece
+	is dealt in a bounded amount of rolls, so any amount of games can be played side by side.
+*/
+enum RandomizerIndex
+{
+	RANDOMIZER_PREVIEW, // never deals a piece that's still in the queue, the original randomizer of this game
+	RANDOMIZER_TGM1,    // 4 rolls to deal a piece that isn't among the last 4, from Tetris: The Grand Master
+	RANDOMIZER_TGM2,    // 6 rolls against the same history, from TGM2: The Absolute PLUS
+	RANDOMIZER_TGM3,    // 6 rolls from a pool of 35 pieces that favors the ones gone the longest, from TGM3: Terror-Instinct
+	RANDOMIZER_BAG,     // every piece once in a shuffled bag of 7, from the guideline games
+	RANDOMIZER_AMOUNT
+};
+typedef enum RandomizerIndex RandomizerIndex;
+
+#define PIECE_TYPES 7
+#define RANDOMIZER_HISTORY 4
+
+typedef struct RandomizerState
+{
+	uint32_t rng; // advanced by every roll
+	unsigned char history[RANDOMIZER_HISTORY]; // last pieces dealt, newest last, all `PIECE_NONE` until the first one is
+	unsigned char pool[PIECE_TYPES]; // pieces of every type left to deal from the bag or the TGM3 pool, up to 35
+	uint32_t order; // every type 3 bits each, from the one dealt the longest ago in the lowest bits to the newest
+} RandomizerState;
+
+// Rules a game is played with, picked when it is created.
+typedef struct GameRules
+{
+	RotationSystemIndex rotation;
+	uint32_t seed; // starting state of the piece randomizer, the same seed and inputs always play the same game
+	RandomizerIndex randomizer;
+} GameRules;
 
 typedef struct GameState
 {
-	Piece *piece;
-	PieceIndex queue[5]; // store the previous pieces in a queue
-	unsigned char *board;
+	GameRules rules;
+	Piece piece;
+	unsigned char queue[QUEUE_SIZE]; // store the previous pieces in a queue
+	uint32_t seed; // seed the game started with, see `GameRules`
+	RandomizerState randomizer; // state of the piece randomizer, see `RandomizerIndex`
+	uint64_t hash; // Zobrist hash of `rows` and `queue`, kept up to date as they change, see `game_hash`
+	unsigned char board[BOARD_WIDTH * BOARD_HEIGHT]; // color of every cell as a `PieceIndex`, only meaningful where `rows` has a block
+	uint16_t rows[BOARD_CEILING + BOARD_HEIGHT + BOARD_FLOOR]; // occupancy of `board` as one bitmask per row, ceiling and floor included, see `ROW`
+	unsigned char heights[BOARD_WIDTH]; // height of the stack in every column, counting from the floor
+#ifdef GAME_DEBUG
+	bool cells[BOARD_HEIGHT][BOARD_WIDTH]; // occupancy kept one cell at a time, for `rows` to be checked against
+#endif
 	uint64_t ticks;
 	unsigned int level;
 	unsigned int score;
-	unsigned int gravity;
+	unsigned int gravity; // in 1/256 G, see `GRAVITY_CURVE`
+	unsigned int fall; // how far the piece has fallen into its next row, in 1/256 rows
 	unsigned int tpu; // ticks per update
-	unsigned int ftr; // fall tickrate
-	unsigned int dhf; // direction hold frames
-	unsigned int das; // Delayed Auto Shift, frames before autorepeat
-	unsigned int are; // spawn delay, ticks are copied into this variable so it can be compared against `ARE_FRAMES` 
-	unsigned int lockticks;  // lock delay, ticks are copied into this variable so it can be compared against `LOCK_DELAY`
+	bool shifting; // the held direction is repeating every frame, see `TIMER_DAS`
+	int clear_y1, clear_y2; // rows of the last locked piece, checked for lines when `TIMER_LINE_CLEAR` fires
+	unsigned char delays[TIMER_AMOUNT]; // frames every `GameTimer` runs for
+	unsigned int timers; // bits of the armed `GameTimer`s
+	unsigned int timer_due[TIMER_AMOUNT]; // tick every armed timer fires on
+	unsigned char timer_next[TIMER_AMOUNT]; // next timer in the same wheel slot
+	unsigned char timer_slots[TIMER_SLOTS]; // first timer of every wheel slot
+	unsigned int input; // `GameInput` bits held this frame
+	unsigned int pressed; // `GameInput` bits already consumed as presses, cleared on release
+	GameEvent events[MAX_EVENTS]; // events raised during the last `step_game` call
+	unsigned int event_count;
 	bool game_over;
 } GameState;
 
-void init_game_state();
-void draw_board();
-void restart_game();
+/*
+	Everything `step_game` reads from a `GameState`, packed without pointers so it can be copied around freely.
+
+	The colors of the stack are left out, the simulation only looks at `rows`. Restoring a snapshot keeps
+	whatever colors `board` had, cells that weren't colored for it are drawn as placeholder blocks. The column
+	heights are left out too and found again from `rows`.
+*/
+typedef struct GameSnapshot
+{
+	uint64_t hash;
+	uint32_t ticks; // only the low 32 bits, over two years of frames
+	RandomizerState randomizer;
+	uint32_t level;
+	uint32_t score;
+	uint16_t gravity;
+	uint16_t rows[BOARD_HEIGHT];
+	Piece piece;
+	unsigned char queue[QUEUE_SIZE];
+	unsigned char fall;
+	unsigned char input;
+	unsigned char pressed;
+	bool shifting;
+	bool game_over;
+	signed char clear_y1, clear_y2;
+	unsigned char timers;
+	unsigned char timer_left[TIMER_AMOUNT]; // frames until every armed timer fires
+} GameSnapshot;
+
+// Start a new game with an empty board and a fresh queue, in place.
+// A game holds no pointers to other memory, so restarting one is just initializing it again.
+void init_game_state(GameState *game, GameRules rules);
+// Allocate and start a new game, see `init_game_state`.
+GameState *new_game_state(GameRules rules);
+// Free a game made by `new_game_state`.
+void free_game_state(GameState *game);
+// Returns a 64-bit Zobrist hash of the board, the active piece, the queue and the randomizer with its kind and state.
+// The board and queue are hashed as they change, so it's cheap enough to check every frame. Timers and counters are left out.
+uint64_t game_hash(GameState *game);
+// Copy the state of a game into a snapshot.
+void save_game(GameState *game, GameSnapshot *snapshot);
+// Bring a game back to the state of a snapshot, the game has to be played with the same `GameRules`.
+void restore_game(GameState *game, const GameSnapshot *snapshot);
+// Advance the game by one frame using the `GameInput` bits held during it.
+// The events raised by the frame are left in `game->events`.
+void step_game(GameState *game, unsigned int input);
+
+// Create a new tetromino from a piece index.
+// Passing index `-1` creates a random piece and adds it to the queue.
+Piece new_piece(GameState *game, int idx);
+// Returns the row masks of a tetromino's 4x4 box in the rotation system of the game.
+const uint16_t *piece_mask(GameState *game, PieceIndex type, Rotation rotation);
+// Returns part of or the entire range of a piece in the Y axis.
+int piece_range(GameState *game, Piece *piece, PieceRange range);
+// Checks if a tetromino of a type and rotation would overlap the walls, the floor or the stack with its box at `x`, `y`.
+// The box may be up to `BOARD_WALL` columns past the walls of the board.
+bool piece_collides(GameState *game, PieceIndex type, Rotation rotation, int x, int y);
+// Returns how many rows a tetromino can fall before it lands on the stack.
+int drop_distance(GameState *game, Piece *piece);
+// Move a tetromino down by up to `cells` rows at once, stopping on top of the stack.
+void drop_piece(GameState *game, Piece *piece, int cells);
+// Move a tetromino by an offset in x and/or y.
+void move_piece(GameState *game, Piece *piece, int x, int y);
+// Rotate a tetromino in a given direction, `1` is clockwise and `-1` counter-clockwise.
+// Blocked rotations try the kicks of the rotation system in order.
+void rotate_piece(GameState *game, Piece *piece, int direction);
+// Lock a tetromino by placing it on the play board.
+void lock_piece(GameState *game, Piece *piece);
+// Clears the full lines between rows `y1` and `y2` in a single pass, returns the amount of lines cleared.
+// The span can be any size, rows outside the board are left alone.
+int clear_lines(GameState *game, int y1, int y2);
+
+// Start a timer so it fires `delays[timer]` frames from now, restarting it if it was already armed.
+// Timers fire at the start of a frame, a delay of zero waits for the next one.
+void arm_timer(GameState *game, GameTimer timer);
+// Stop an armed timer without firing it.
+void cancel_timer(GameState *game, GameTimer timer);
+bool timer_armed(GameState *game, GameTimer timer);
+
+bool every_n_frames(GameState *game, unsigned int frames);
+// Returns the gravity of a level in 1/256 G.
+unsigned int level_gravity(unsigned int level);
+
+// Start the randomizer of the game and fill the queue with its first pieces.
+void init_queue(GameState *game);
+// Returns the next piece of the randomizer of the game.
+PieceIndex deal_piece(GameState *game);
+// Move the queue up by one, dropping its first piece, and put a piece at its end.
+void update_queue(GameState *game, PieceIndex piece);
+
+#ifdef GAME_DEBUG
+/*
+	Debug builds count every heap allocation made by the files that include this header, the game, the renderer
+	and the main loop among them, by sending `malloc`, `calloc`, `realloc` and `free` through counting wrappers.
+	`step_game` asserts that a frame never makes one, the game asserts the same for every frame it draws.
+	The counters aren't atomic, allocations should only be made from one thread while they are checked.
+*/
+#include <stdlib.h>
 
-bool every_n_frames(unsigned int frames);
-bool key_is_down_buffered(SDL_KeyCode key);
+// Heap allocations made so far that weren't freed yet.
+extern unsigned int game_allocations;
+// Heap allocations made so far, freed or not.
+extern unsigned long game_allocation_count;
 
-void init_queue();
-unsigned int new_index(unsigned int seed);
-bool index_in_queue(int idx);
-void update_queue(int idx);
+void *game_malloc(size_t size);
+void *game_calloc(size_t count, size_t size);
+void *game_realloc(void *ptr, size_t size);
+void game_free(void *ptr);
 
-// The game's state.
-// Yes, I was too lazy to try and implement it into the engine manager.
-GameState *game_state = NULL;
+#define malloc(size) game_malloc(size)
+#define calloc(count, size) game_calloc(count, size)
+#define realloc(ptr, size) game_realloc(ptr, size)
+#define free(ptr) game_free(ptr)
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "journal.h"
+
+static const char JOURNAL_MAGIC[4] = {'R', '9', '7', 'J'};
+
+_Static_assert(JOURNAL_FRAMES >= 2 * JOURNAL_INTERVAL, "the ring has to reach back to the older keyframe");
+
+static uint64_t keyframe_check(const ReplayKeyframe *keyframe)
+{
+    const unsigned char *bytes = (const unsigned char *)keyframe;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < sizeof(ReplayKeyframe); i++)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Newest keyframe that was written whole and that the ring still has every input after, or `NULL`.
+static const ReplayKeyframe *last_keyframe(SessionJournal *journal)
+{
+    JournalHeader *header = journal->header;
+    if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || header->version != JOURNAL_VERSION ||
+        header->header_size != sizeof(JournalHeader) || header->engine != ENGINE_VERSION || !header->active)
+        return NULL;
+
+    const ReplayKeyframe *last = NULL;
+    uint64_t frames = header->frames;
+    for (int i = 0; i < 2; i++)
+    {
+        const ReplayKeyframe *keyframe = &header->keyframes[i].keyframe;
+        if (keyframe->frame <= frames && frames - keyframe->frame <= JOURNAL_FRAMES &&
+            header->keyframes[i].check == keyframe_check(keyframe) && (last == NULL || keyframe->frame > last->frame))
+            last = keyframe;
+    }
+    return last;
+}
+
+static void take_keyframe(SessionJournal *journal, GameState *game, uint64_t frame)
+{
+    JournalKeyframe *slot = &journal->header->keyframes[frame / JOURNAL_INTERVAL % 2];
+    // A crash before the checksum is in leaves a slot that doesn't match it
+    slot->check = 0;
+    slot->keyframe.frame = frame;
+    save_game(game, &slot->keyframe.snapshot);
+    memcpy(slot->keyframe.colors, game->board, sizeof(slot->keyframe.colors));
+    *(volatile uint64_t *)&slot->check = keyframe_check(&slot->keyframe);
+}
+
+bool open_journal(SessionJournal *journal, const char *path)
+{
+    memset(journal, 0, sizeof(SessionJournal));
+    if (!map_file(&journal->mapping, path, sizeof(JournalHeader) + JOURNAL_FRAMES, true))
+        return false;
+    journal->header = journal->mapping.data;
+    journal->inputs = (unsigned char *)journal->mapping.data + sizeof(JournalHeader);
+    return true;
+}
+
+bool has_session(SessionJournal *journal)
+{
+    return last_keyframe(journal) != NULL;
+}
+
+long restore_session(SessionJournal *journal, GameState *game)
+{
+    const ReplayKeyframe *keyframe = last_keyframe(journal);
+    if (keyframe == NULL)
+        return -1;
+
+    init_game_state(game, journal->header->rules);
+    restore_game(game, &keyframe->snapshot);
+    memcpy(game->board, keyframe->colors, sizeof(keyframe->colors));
+    uint64_t frames = journal->header->frames;
+    for (uint64_t frame = keyframe->frame; frame < frames; frame++)
+        step_game(game, journal->inputs[frame % JOURNAL_FRAMES]);
+    return frames;
+}
+
+void start_session(SessionJournal *journal, GameState *game, GameRules rules)
+{
+    JournalHeader *header = journal->header;
+    header->active = 0;
+    // Clearing the whole journal also touches every page of it now rather than in the middle of the game
+    memset(journal->mapping.data, 0, journal->mapping.size);
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header->version = JOURNAL_VERSION;
+    header->header_size = sizeof(JournalHeader);
+    header->rules = rules;
+    header->engine = ENGINE_VERSION;
+    header->frames = 0;
+    take_keyframe(journal, game, 0);
+    *(volatile uint32_t *)&header->active = 1;
+}
+
+void log_input(SessionJournal *journal, GameState *game, unsigned int input)
+{
+    JournalHeader *header = journal->header;
+    uint64_t frame = header->frames;
+    journal->inputs[frame % JOURNAL_FRAMES] = input;
+    header->frames = ++frame;
+    if (frame % JOURNAL_INTERVAL == 0)
+        take_keyframe(journal, game, frame);
+    if (game->game_over)
+        end_session(journal);
+}
+
+void end_session(SessionJournal *journal)
+{
+    *(volatile uint32_t *)&journal->header->active = 0;
+}
+
+void close_journal(SessionJournal *journal)
+{
+    unmap_file(&journal->mapping);
+    journal->header = NULL;
+    journal->inputs = NULL;
+}
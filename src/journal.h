@@ -0,0 +1,71 @@
+#ifndef JOURNAL_HEADER
+#define JOURNAL_HEADER
+
+// Session journal: the game being played, kept in a file mapped into memory so it outlives a crash of the game.
+// Writing to it is only copying into memory, the system writes the pages back to the file on its own.
+
+#include "game.h"
+#include "replay.h"
+#include "mapping.h"
+
+/*
+	Journal file layout, copied straight out of memory and only meant to be read back by the same build:
+
+	`JournalHeader`, then the `GameInput` bits of the last `JOURNAL_FRAMES` frames as a ring of one byte each,
+	the input of frame `f` being at `f % JOURNAL_FRAMES`.
+
+	A keyframe is taken every `JOURNAL_INTERVAL` frames into one of two slots, taking turns, so a crash
+	while one is written still leaves the other. Each slot carries a checksum that is written last and a
+	slot that doesn't match it is skipped. Restoring goes from the newest good keyframe and plays the
+	inputs of the ring from there.
+
+	Nothing is ever flushed, a crash of the game loses nothing since the pages belong to the system,
+	but a crash of the system loses whatever it hadn't written back yet.
+*/
+#define JOURNAL_VERSION 3
+#define JOURNAL_FRAMES 4096 // a little over a minute
+#define JOURNAL_INTERVAL KEYFRAME_INTERVAL
+
+typedef struct JournalKeyframe
+{
+	uint64_t check; // checksum of `keyframe`
+	ReplayKeyframe keyframe;
+} JournalKeyframe;
+
+typedef struct JournalHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t header_size; // size of `JournalHeader`, to tell apart journals of other builds
+	uint32_t active; // a game is being played, cleared once it's over
+	GameRules rules;
+	uint32_t engine; // `ENGINE_VERSION` of the build that journaled the game
+	volatile uint64_t frames; // frames written to the ring, bumped after the input of the frame is in
+	JournalKeyframe keyframes[2];
+} JournalHeader;
+
+typedef struct SessionJournal
+{
+	FileMapping mapping;
+	JournalHeader *header;
+	volatile unsigned char *inputs; // the ring
+} SessionJournal;
+
+// Map a journal, creating it if needed. What it holds is left alone until `start_session`.
+// Returns `false` if it couldn't be mapped.
+bool open_journal(SessionJournal *journal, const char *path);
+// Whether the journal holds a game that was still being played when the last session stopped.
+bool has_session(SessionJournal *journal);
+// Bring `game` back to the last frame the journal holds and keep journaling it from there.
+// Returns the amount of frames of the game, or `-1` if there was no game to restore.
+long restore_session(SessionJournal *journal, GameState *game);
+// Start journaling a game that was just started with `rules`.
+void start_session(SessionJournal *journal, GameState *game, GameRules rules);
+// Journal the input a frame was just played with, once `step_game` is done with it.
+// The session ends by itself once the game is over.
+void log_input(SessionJournal *journal, GameState *game, unsigned int input);
+// Forget the game being journaled, the next launch won't offer to restore it.
+void end_session(SessionJournal *journal);
+void close_journal(SessionJournal *journal);
+
+#endif
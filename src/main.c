@@ -1,6 +1,11 @@
 #include "tangram.h"
 #include "shader.h"
 #include "game.h"
+#include "replay.h"
+#include "journal.h"
+#ifdef GAME_DEBUG
+#include <assert.h>
+#endif
 
 // ENGINE CODE
 
@@ -17,8 +22,10 @@ TangramResult tangram_test_pointer(void *ptr)
 void init_screen()
 {
     size_t size = width * height * sizeof(unsigned int);
-    tangram.screen = malloc(size);
-    memset(tangram.screen, 0, size);
+    tangram.screen.pixels = malloc(size);
+    tangram.screen.width = width;
+    tangram.screen.height = height;
+    memset(tangram.screen.pixels, 0, size);
 }
 
 void init_clock(TangramClock *clock)
@@ -26,6 +33,7 @@ void init_clock(TangramClock *clock)
     clock->now = SDL_GetPerformanceCounter();
     clock->last = 0;
     clock->dt = 0;
+    clock->accumulator = 0;
 }
 
 void tick_clock(TangramClock *clock)
@@ -34,7 +42,7 @@ void tick_clock(TangramClock *clock)
     clock->now = SDL_GetPerformanceCounter();
 
     clock->dt = (double)((clock->now - clock->last) / (double)SDL_GetPerformanceFrequency());
-    game_state->ticks++;
+    clock->accumulator += clock->now - clock->last;
 }
 
 bool key_is_down(SDL_KeyCode key)
@@ -44,19 +52,15 @@ bool key_is_down(SDL_KeyCode key)
 
 bool key_is_pressed(SDL_KeyCode key)
 {
-    if (key_is_down(key) && !tangram.pressed.keys[key])
+    SDL_Scancode scancode = SDL_GetScancodeFromKey(key);
+    if (key_is_down(key) && !tangram.pressed.keys[scancode])
     {
-        tangram.pressed.keys[key] = true;
+        tangram.pressed.keys[scancode] = true;
         return true;
     }
     return false;
 }
 
-bool key_is_down_buffered(SDL_KeyCode key)
-{
-    return key_is_down(key) && every_n_frames(game_state->tpu);
-}
-
 bool key_is_up(SDL_KeyCode key)
 {
     return !tangram.keystate[SDL_GetScancodeFromKey(key)];
@@ -80,111 +84,6 @@ void free_textures()
     stbi_image_free(tangram.textures.spritesheet);
 }
 
-void draw_clear(unsigned int color)
-{
-    unsigned int *p = tangram.screen;
-    unsigned int *end = tangram.screen + width * height;
-    unsigned int c = RGB_TO_BGR(color);
-    while (p < end)
-        *p++ = c;
-}
-
-void draw_pixel(int x, int y, unsigned int color)
-{
-    if (x >= 0 && x < width && y >= 0 && y < height)
-    {
-        unsigned int *pixel = &tangram.screen[((height - 1 - y) * width) + x];
-        if ((color & 0xFF000000) != 0xFF000000)
-            *pixel = RGB_TO_BGR(color);
-    }
-}
-
-void draw_line(Point from, Point to, unsigned int color)
-{
-    // Bresenham's line algorithm
-    float dx = fabs(to.x - from.x);
-    float dy = fabs(to.y - from.y);
-    float sx = from.x < to.x ? 1.0f : -1.0f;
-    float sy = from.y < to.y ? 1.0f : -1.0f;
-    float err = dx - dy;
-
-    for (int i = 0; i <= fmaxf(dx, dy); i++)
-    {
-        draw_pixel((int)(from.x + 0.5f), (int)(from.y + 0.5f), color);
-        if (from.x == to.x && from.y == to.y)
-            break;
-        int e2 = 2.0f * err;
-        if (e2 > -dy)
-        {
-            err -= dy;
-            from.x += sx;
-        }
-        if (e2 < dx)
-        {
-            err += dx;
-            from.y += sy;
-        }
-    }
-}
-
-void draw_rectangle(Point from, Point to, unsigned int color, bool outline)
-{
-    const Point A = (Point){from.x, from.y};
-    const Point B = (Point){to.x, from.y};
-    const Point C = (Point){to.x, to.y};
-    const Point D = (Point){from.x, to.y};
-    if (outline)
-    {
-        draw_line(A, B, color);
-        draw_line(B, C, color);
-        draw_line(C, D, color);
-        draw_line(D, A, color);
-    }
-    else
-    {
-        for (int rx = from.x; rx < to.x; rx++)
-            for (int ry = from.y; ry < to.y; ry++)
-                draw_pixel(rx, ry, color);
-    }
-}
-
-void draw_texture(TangramTexture *texture, Point pos, Point uv, Point size, float scale, unsigned int blend)
-{
-    // the image will pretend to have 3 channels but all textures are loaded with 4
-    int channels = 4;
-
-    // Extract blend color channels
-    unsigned char blend_r = (blend >> 16) & 0xFF;
-    unsigned char blend_g = (blend >> 8) & 0xFF;
-    unsigned char blend_b = blend & 0xFF;
-    float factor = ((blend >> 24) & 0xFF) / 255.0f; // Extract alpha as a blend factor
-
-    for (int tx = 0; tx < size.x; tx++)
-        for (int ty = 0; ty < size.y; ty++)
-        {
-            int dtx = (int)(uv.x + (float)tx);
-            int dty = (int)(uv.y + (float)ty);
-
-            int pixel = (dty * texture->w + dtx) * channels;
-            unsigned char r = texture->data[pixel];
-            unsigned char g = texture->data[pixel + 1];
-            unsigned char b = texture->data[pixel + 2];
-            unsigned char a = texture->data[pixel + 3];
-
-            // Apply blending to the color
-            r = (unsigned char)(r * (1.0f - factor) + blend_r * factor);
-            g = (unsigned char)(g * (1.0f - factor) + blend_g * factor);
-            b = (unsigned char)(b * (1.0f - factor) + blend_b * factor);
-
-            unsigned int color = 0;
-            color |= (r << 16);
-            color |= (g << 8);
-            color |= b;
-
-            draw_pixel(pos.x + tx, pos.y + ty, color);
-    }
-}
-
 HSTREAM new_sound(const char *filename)
 {
     if (filename != NULL)
@@ -227,516 +126,164 @@ void free_sounds()
 
 // GAME CODE
 
-void init_queue()
-{
-    for (int i = 0; i < QUEUE_SIZE; i++)
-    {
-        unsigned int index = ((unsigned int)((genrand_real3() * (INT32_MAX - 1) + SDL_GetTicks() + 0xb297afff)) % 7) + 1;
-        while (index_in_queue(index))
-            index = ((unsigned int)((genrand_real3() * (INT32_MAX - 1) + SDL_GetTicks() + 0x99128bea)) % 7) + 1;
-        game_state->queue[i] = index;
-    }
-}
-
-bool index_in_queue(int idx)
-{
-    for (int i = 0; i < QUEUE_SIZE; i++)
-    {
-        if (game_state->queue[i] == idx)
-            return true;
-    }
-    return false;
-}
-
-unsigned int new_index(unsigned int seed)
-{
-    unsigned int n;
-    do
-    {
-        n = ((unsigned int)((genrand_real3() * (INT32_MAX - 1)) + seed) % 7) + 1;
-    } while (index_in_queue(n));
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "New index: %u", n);
-    return n;
-}
-
-void update_queue(int idx)
-{
-    for (int i = 0; i < QUEUE_SIZE; i++)
-        game_state->queue[i] = game_state->queue[i + 1];
-    game_state->queue[QUEUE_SIZE - 1] = idx;
-}
-
-void init_game_state()
-{
-    game_state = malloc(sizeof(GameState));
-    size_t size = BOARD_WIDTH * BOARD_HEIGHT * sizeof(unsigned char);
-    game_state->board = malloc(size);
-    memset(game_state->board, 0, size);
-
-    init_queue();
-
-    game_state->piece = new_piece(-1);
-    game_state->game_over = false;
-    game_state->ticks = 0;
-    game_state->gravity = 1;
-    game_state->ftr = fps;
-    game_state->tpu = 1;
-    game_state->level = 0;
-    game_state->score = 0;
-    game_state->das = DAS_FRAMES;
-    game_state->are = game_state->ticks;
-    game_state->lockticks = game_state->ticks;
-}
-
-bool every_n_frames(unsigned int frames)
-{
-    return game_state->ticks % frames == 0;
-}
-
-void draw_board()
-{
-    float X_OFFSET = floor(width * 0.5 - BOARD_WIDTH * CELL_SIZE * 0.5);
-    float Y_OFFSET = floor(height * 0.5 - BOARD_HEIGHT * CELL_SIZE * 0.5);
-    // Draw board pane
-    draw_rectangle(
-        (Point){X_OFFSET, Y_OFFSET},
-        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
-        0, false);
-    // Draw piece
-    if (game_state->piece != NULL && !game_state->piece->locked)
-    {
-        Piece *p = game_state->piece;
-        for (int b = 0; b < 4; b++)
-        {
-            unsigned int bx = p->blocks[b].x;
-            unsigned int by = p->blocks[b].y;
-            unsigned int color = PIECE_COLORS[p->blocks[b].piece];
-
-            draw_texture(
-                tangram.textures.spritesheet,
-                (Point){X_OFFSET + bx * CELL_SIZE, Y_OFFSET + by * CELL_SIZE},
-                (Point){(float)p->blocks[b].piece * CELL_SIZE, 0.0f},
-                (Point){CELL_SIZE, CELL_SIZE},
-                1.0f, 0xFFFFFF);
-        }
-    }
-    // Draw queue pane
-    draw_rectangle(
-        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE + 32, Y_OFFSET},
-        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE + 128, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
-        0xFFFFFF, true);
-    // Draw piece queue
-    for (int q = 1; q < QUEUE_SIZE; q++)
-    {
-        Piece *next = new_piece(game_state->queue[q]);
-        for (int n = 0; n < 4; n++)
-        {
-            unsigned int nx = next->blocks[n].x;
-            unsigned int ny = next->blocks[n].y;
-            unsigned int color = PIECE_COLORS[next->blocks[n].piece];
-
-            Point draw_position = (Point){
-                X_OFFSET + (BOARD_WIDTH * CELL_SIZE) + nx * CELL_SIZE,
-                Y_OFFSET + (q - 1) * BOARD_HEIGHT * 3 + ny * CELL_SIZE + CELL_SIZE};
-
-            draw_texture(
-                tangram.textures.spritesheet,
-                draw_position,
-                (Point){(float)next->blocks[n].piece * CELL_SIZE, 0.0f},
-                (Point){CELL_SIZE, CELL_SIZE},
-                1.0f, 0xFFFFFF);
-        }
-        free(next);
-    }
-    // Draw board
-    for (int bx = 0; bx < BOARD_WIDTH; bx++)
-    {
-        for (int by = 0; by < BOARD_HEIGHT; by++)
-        {
-            unsigned char *piece = &game_state->board[by * BOARD_WIDTH + bx];
-            if (*piece != PIECE_NONE)
-            {
-                draw_texture(
-                    tangram.textures.spritesheet,
-                    (Point){X_OFFSET + bx * CELL_SIZE, Y_OFFSET + by * CELL_SIZE},
-                    (Point){*piece * CELL_SIZE, 0.0f},
-                    (Point){CELL_SIZE, CELL_SIZE},
-                    1.0f, 0xE0000000);
-                bool top_free = game_state->board[by * BOARD_WIDTH + bx - BOARD_WIDTH] == PIECE_NONE;
-                bool left_free = bx > 0 && game_state->board[by * BOARD_WIDTH + bx - 1] == PIECE_NONE;
-                bool right_free = bx < BOARD_WIDTH && game_state->board[by * BOARD_WIDTH + bx + 1] == PIECE_NONE;
-                bool bottom_free = by < BOARD_HEIGHT && game_state->board[by * BOARD_WIDTH + bx + BOARD_WIDTH] == PIECE_NONE;
-                if (top_free)
-                {
-                    draw_line(
-                        (Point){X_OFFSET + bx * CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE},
-                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE},
-                        0xFFFFFF);
-                }
-                if (left_free)
-                {
-                    draw_line(
-                        (Point){X_OFFSET + bx * CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE},
-                        (Point){X_OFFSET + bx * CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
-                        0xFFFFFF);
-                }
-                if (right_free)
-                {
-                    draw_line(
-                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE},
-                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
-                        0xFFFFFF);
-                }
-                if (bottom_free)
-                {
-                    draw_line(
-                        (Point){X_OFFSET + bx * CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
-                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
-                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
-                        0xFFFFFF);
-                }
-            }
-        }
-    }
-    // Draw border stroke
-    draw_rectangle(
-        (Point){X_OFFSET, Y_OFFSET},
-        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
-        0xFFFFFF, true);
-}
-
-Block new_block(unsigned short data)
-{
-    Block b;
-    b.unused = data >> 15;
-    b.piece = (data & 0x7000) >> 12;
-    b.rotation = (data & 0xC00) >> 10;
-    b.y = (data & 0x1F0) >> 5;
-    b.x = data & 0x1F;
-    return b;
-}
-
-Piece *new_piece(int idx)
-{
-    Piece *p;
-    p = malloc(sizeof(Piece));
-    p->locked = 0;
-    p->coll = 0;
-
-    PieceIndex index = idx;
-    int initial_dir = 0;
-
-    if (index == -1)
-    {
-        index = new_index(SDL_GetTicks() + 0xb297afff);
-        update_queue(index);
-        index = game_state->queue[0];
-        // game_state->dhf = 0;
-        if (tangram.keystate != NULL)
-        {
-            if (key_is_down(SDLK_z))
-            {
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Detected counterclockwise IRS!");
-                initial_dir = -1;
-            }
-            else if (key_is_down(SDLK_x))
-            {
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Detected clockwise IRS!");
-                initial_dir = 1;
-            }
-        }
-    }
-
-    switch (index)
-    {
-    case PIECE_NONE:
-        return NULL;
-    case PIECE_I:
-        p->blocks[0] = new_block(0x1003);
-        p->blocks[1] = new_block(0x1004);
-        p->blocks[2] = new_block(0x1005);
-        p->blocks[3] = new_block(0x1006);
-        break;
-    case PIECE_J:
-        p->blocks[0] = new_block(0x2004);
-        p->blocks[1] = new_block(0x2024);
-        p->blocks[2] = new_block(0x2025);
-        p->blocks[3] = new_block(0x2026);
-        break;
-    case PIECE_L:
-        p->blocks[0] = new_block(0x3006);
-        p->blocks[1] = new_block(0x3024);
-        p->blocks[2] = new_block(0x3025);
-        p->blocks[3] = new_block(0x3026);
-        break;
-    case PIECE_O:
-        p->blocks[0] = new_block(0x4004);
-        p->blocks[1] = new_block(0x4005);
-        p->blocks[2] = new_block(0x4024);
-        p->blocks[3] = new_block(0x4025);
-        break;
-    case PIECE_S:
-        p->blocks[0] = new_block(0x5005);
-        p->blocks[1] = new_block(0x5006);
-        p->blocks[2] = new_block(0x5024);
-        p->blocks[3] = new_block(0x5025);
-        break;
-    case PIECE_Z:
-        p->blocks[0] = new_block(0x6004);
-        p->blocks[1] = new_block(0x6005);
-        p->blocks[2] = new_block(0x6025);
-        p->blocks[3] = new_block(0x6026);
-        break;
-    case PIECE_T:
-        p->blocks[0] = new_block(0x7005);
-        p->blocks[1] = new_block(0x7024);
-        p->blocks[2] = new_block(0x7025);
-        p->blocks[3] = new_block(0x7026);
-        break;
-    default:
-        break;
-    }
-
-    if (idx == -1)
-    {
-        if (initial_dir != 0)
-            play_sound(SOUND_IRS, 0.9f);
-
-        play_sound(game_state->queue[1], 1.0f);
-
-        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Spawned piece #%u", index);
+// The game's state.
+// Yes, I was too lazy to try and implement it into the engine manager.
+// It lives for the whole program, restarting only initializes it again.
+GameState game;
+GameState *game_state = &game;
+// Rules every new game is started with, picked from the command line.
+GameRules game_rules = {ROTATION_SRS};
+// Whether `--seed` fixed the seed of every game instead of picking a random one.
+bool fixed_seed = false;
+// Replay file every game is recorded into when `--record` is passed, restarting starts it over.
+const char *recording_path = NULL;
+FILE *recording = NULL;
+ReplayRecorder recorder;
+#ifdef GAME_DEBUG
+// Heap allocations left once the game was set up, every restart has to come back to them.
+unsigned int setup_allocations;
+#endif
+// Journal the game being played is kept in, so it can be restored if the game crashes. Changed with `--journal`.
+const char *journal_path = "session.journal";
+SessionJournal journal;
+bool journaling = false;
+// Replay watched instead of playing when `--play` is passed.
+const char *replay_path = NULL;
+ReplayPlayer replay;
+unsigned int replay_speed = 1; // frames played per tick, only the last one is drawn
+
+// The falling piece at the end of the last two ticks, `piece_frames[piece_frame]` being the latest.
+// Drawing blends between both so the piece moves smoothly on displays faster than the tick rate.
+PieceFrame piece_frames[2];
+unsigned int piece_frame = 0;
+
+// Saves the falling piece after a tick over the oldest frame.
+void save_piece_frame()
+{
+    Piece *p = &game_state->piece;
+    piece_frame ^= 1;
+    piece_frames[piece_frame].piece = *p;
+    piece_frames[piece_frame].y = p->y + (p->coll ? 0.0f : game_state->fall / 256.0f);
+}
+
+// Forgets the previous tick so a new game doesn't blend with the last one.
+void reset_piece_frames()
+{
+    save_piece_frame();
+    piece_frames[piece_frame ^ 1] = piece_frames[piece_frame];
+}
+
+unsigned int read_input()
+{
+    unsigned int input = 0;
+    if (key_is_down(SDLK_LEFT))
+        input |= INPUT_LEFT;
+    if (key_is_down(SDLK_RIGHT))
+        input |= INPUT_RIGHT;
+    if (key_is_down(SDLK_DOWN))
+        input |= INPUT_DOWN;
+    if (key_is_down(SDLK_z))
+        input |= INPUT_CCW;
+    if (key_is_down(SDLK_x))
+        input |= INPUT_CW;
+    if (key_is_down(SDLK_UP))
+        input |= INPUT_SONIC;
+    if (key_is_down(SDLK_SPACE))
+        input |= INPUT_HARD;
+    return input;
+}
+
+void handle_event(GameEvent *event)
+{
+    switch (event->type)
+    {
+    case EVENT_PIECE_SPAWN:
+        play_sound(event->data, 1.0f);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Spawned piece #%u", game_state->queue[0]);
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "The queue now is: [%d, %d, %d, %d, %d]",
                     game_state->queue[0],
                     game_state->queue[1],
                     game_state->queue[2],
                     game_state->queue[3],
                     game_state->queue[4]);
-    }
-
-    return p;
-}
-
-unsigned int piece_range(Piece *piece, PieceRange range)
-{
-    unsigned int a = piece->blocks[0].y;
-    unsigned int b = piece->blocks[1].y;
-    for (int i = 0; i < 4; i++)
-    {
-        int py = piece->blocks[i].y;
-        if (py < a)
-            a = py;
-        if (py > b)
-            b = py;
-    }
-
-    switch (range)
-    {
-    case HIGHEST_BLOCK:
-        return a;
-    case LOWEST_BLOCK:
-        return b;
-    case FULL_RANGE:
-        return a - b;
-    }
-}
-
-void move_piece(Piece *piece, int x, int y)
-{
-    for (int i = 0; i < 4; i++)
-    {
-        int dx = piece->blocks[i].x + x;
-        int dy = piece->blocks[i].y + y;
-        if (dy >= BOARD_HEIGHT || (game_state->board[dy * BOARD_WIDTH + dx] != PIECE_NONE && x == 0))
-        {
-            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Skipping lock delay...");
-            play_sound(SOUND_PIECECOLLIDE, 0.9f);
-            lock_piece(piece);
-            return;
-        }
-        if (
-            dx < 0 || dx >= BOARD_WIDTH ||
-            game_state->board[dy * BOARD_WIDTH + dx] != PIECE_NONE)
-            return;
-    }
-
-    // Move the entire piece when all blocks pass the check
-    for (int i = 0; i < 4; i++)
-    {
-        piece->blocks[i].x += x;
-        piece->blocks[i].y += y;
-    }
-
-    unsigned int ly = piece_range(piece, LOWEST_BLOCK);
-    for (int i = 0; i < 4; i++)
-    {
-        if (piece->blocks[i].y == ly)
-        {
-            unsigned int cell = game_state->board[(piece->blocks[i].y + 1) * BOARD_WIDTH + piece->blocks[i].x];
-            if (cell != PIECE_NONE && !piece->coll)
-            {
-                piece->coll = true;
-                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Piece is locked now! Waiting for lock delay to run out...");
-                play_sound(SOUND_PIECECOLLIDE, 0.9f);
-                game_state->lockticks = game_state->ticks;
-            }
-            if (cell == PIECE_NONE && piece->coll)
-                piece->coll = false;
-            break;
-        }
+        break;
+    case EVENT_IRS:
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Detected %s IRS!", event->data == 1 ? "clockwise" : "counterclockwise");
+        play_sound(SOUND_IRS, 0.9f);
+        break;
+    case EVENT_PIECE_COLLIDE:
+        play_sound(SOUND_PIECECOLLIDE, 0.9f);
+        break;
+    case EVENT_PIECE_LOCK:
+        play_sound(SOUND_PIECELOCK, 1.0f);
+        break;
+    case EVENT_LINE_CLEAR:
+        play_sound(SOUND_DISAPPEAR, 0.7f);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Line %u has been cleared!!", event->data);
+        break;
+    case EVENT_GAME_OVER:
+        BASS_ChannelStop(tangram.music);
+        break;
     }
 }
 
-void rotate_piece(Piece *piece, int direction)
+void start_game()
 {
-    // O doesn't rotate!
-    if (piece->blocks[0].piece == PIECE_O)
-        return;
-
-    int prev_r = piece->blocks[0].rotation;
-    int r = piece->blocks[0].rotation + direction;
-    if (r < ROT_0)
-        r = ROT_270;
-    else if (r > ROT_270)
-        r = ROT_0;
-
-    Block pivot;
-    bool ok = true;
-    unsigned int from_center = 1;
-
-    unsigned int rx[4];
-    unsigned int ry[4];
-    for (int i = 0; i < 4; i++)
+    if (recording != NULL)
     {
-        rx[i] = pivot.x - from_center + ROTATION_DATA[piece->blocks[i].piece - 1][r][i][0];
-        ry[i] = pivot.y - from_center + ROTATION_DATA[piece->blocks[i].piece - 1][r][i][1];
+        // The last game's replay ends with the hash of how it went
+        finish_recording(&recorder, game_state);
+        fclose(recording);
+        recording = NULL;
     }
 
-    if (piece->blocks[0].piece == PIECE_I)
-        pivot = piece->blocks[1];
-    else if (piece->blocks[0].piece == PIECE_S)
-        pivot = piece->blocks[3];
-    else
-        pivot = piece->blocks[2];
+    if (!fixed_seed)
+        game_rules.seed = genrand_int32();
+    init_game_state(game_state, game_rules);
+    reset_piece_frames();
+    if (journaling)
+        start_session(&journal, game_state, game_rules);
 
-    int offset_x = 0;
-    int offset_y = 0;
-    for (int i = 0; i < 4; i++)
+    if (recording_path != NULL)
     {
-        piece->blocks[i].rotation = r;
-        rx[i] = pivot.x - 1 + ROTATION_DATA[piece->blocks[i].piece - 1][piece->blocks[i].rotation][i][0];
-        ry[i] = pivot.y - 1 + ROTATION_DATA[piece->blocks[i].piece - 1][piece->blocks[i].rotation][i][1];
-        if (
-            rx[i] >= 0 && ry[i] >= 0 && rx[i] < BOARD_WIDTH && ry[i] < BOARD_HEIGHT)
-        {
-            /*
-            if (rx[i] != PIECE_NONE || ry[i] != PIECE_NONE)
-            {
-                // wall kicks
-                int p = piece->blocks[i].piece == PIECE_I;
-                int r = piece->blocks[i].rotation;
-
-                for (int n = 0; n < WALLKICK_TESTS; n++)
-                {
-                    int dir = direction < 0;
-                    int test_x = WALLKICK_DATA[p][r][dir][n][0];
-                    int test_y = WALLKICK_DATA[p][r][dir][n][1];
-
-                    ok = check_move(piece, test_x, test_y);
-                    if (!ok)
-                        continue;
-
-                    offset_x = test_x;
-                    offset_y = test_y;
-                    SDL_LogInfo(
-                        SDL_LOG_CATEGORY_APPLICATION,
-                        "Wall kick test #%d passed for piece #%d when going from rotation %d to %d!",
-                        n + 1, piece->blocks[i].piece, prev_r, r
-                    );
-                    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "The new offset is (%d, %d)", offset_x, offset_y);
-                    break;
-                }
-            }
-            */
-        }
-        else
-        {
-            ok = false;
-            break;
-        }
-    }
-    if (ok)
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            piece->blocks[i].x = rx[i];
-            piece->blocks[i].y = ry[i];
-        }
+        recording = fopen(recording_path, "wb");
+        if (recording == NULL || !start_recording(&recorder, recording, game_rules, true))
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to record replay into %s", recording_path);
     }
 }
 
-void lock_piece(Piece *piece)
+void restart_game()
 {
-    piece->locked = true;
-    for (int i = 0; i < 4; i++)
-    {
-        int px = piece->blocks[i].x;
-        int py = piece->blocks[i].y;
-        game_state->board[py * BOARD_WIDTH + px] = piece->blocks[i].piece;
-    }
-    play_sound(SOUND_PIECELOCK, 1.0f);
-    unsigned int y1 = piece_range(piece, HIGHEST_BLOCK);
-    unsigned int y2 = piece_range(piece, LOWEST_BLOCK);
-    int diff = y2 - y1 + 1;
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Checking lines %d to %d", y1, y2);
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Checking %d inside check_lines", diff);
-
-    for (int y = y1; y <= y2; y++)
-        check_line(y);
-
-    game_state->level++;
-    game_state->are = game_state->ticks;
+    BASS_ChannelPlay(tangram.music, 1);
+    start_game();
+#ifdef GAME_DEBUG
+    // Restarting mustn't leave anything allocated behind
+    assert(game_allocations == setup_allocations);
+#endif
 }
 
-void check_line(unsigned int y)
+// Restore the game the journal was left with if the player wants it back, returns `false` to start a new one instead.
+bool restore_journal()
 {
-    if (y <= 0)
-    {
-        game_state->game_over = true;
-        BASS_ChannelStop(tangram.music);
-        return;
-    }
-
-    for (int x = 0; x < BOARD_WIDTH; x++)
-    {
-        if (game_state->board[y * BOARD_WIDTH + x] == PIECE_NONE)
-            return;
-    }
-
-    play_sound(SOUND_DISAPPEAR, 0.7f);
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Line %d has been cleared!!", y);
-    for (int x = 0; x < BOARD_WIDTH; x++)
-        game_state->board[y * BOARD_WIDTH + x] = PIECE_NONE;
-
-    for (int dy = y; dy > 0; dy--)
-        for (int dx = 0; dx < BOARD_WIDTH; dx++)
-            game_state->board[dy * BOARD_WIDTH + dx] = game_state->board[dy * BOARD_WIDTH + dx - BOARD_WIDTH];
+    if (!has_session(&journal) || restore_session(&journal, game_state) < 0)
+        return false;
 
-    game_state->score += 100 + game_state->level * 2;
-    game_state->level++;
-}
+    char message[128];
+    sprintf(message, "The last game stopped at level %u with a score of %u. Resume it?", game_state->level, game_state->score);
+    const SDL_MessageBoxButtonData buttons[] = {
+        {SDL_MESSAGEBOX_BUTTON_ESCAPEKEY_DEFAULT, 0, "New game"},
+        {SDL_MESSAGEBOX_BUTTON_RETURNKEY_DEFAULT, 1, "Resume"},
+    };
+    const SDL_MessageBoxData box = {SDL_MESSAGEBOX_INFORMATION, tangram.window, (const char *)title, message, 2, buttons, NULL};
+    int button = 0;
+    if (SDL_ShowMessageBox(&box, &button) != 0 || button != 1)
+        return false;
 
-void restart_game()
-{
-    BASS_ChannelPlay(tangram.music, 1);
-    free(game_state);
-    init_game_state();
+    // A replay has to start from the first frame, the resumed game is only recorded from the next restart on
+    if (recording_path != NULL)
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Resumed game isn't recorded into %s", recording_path);
+    reset_piece_frames();
+    return true;
 }
 
 // ENGINE EVENTS
@@ -776,6 +323,8 @@ static int tangram_event_setup()
 
     tangram.gl.context = SDL_GL_CreateContext(tangram.window);
     SDL_GL_MakeCurrent(tangram.window, tangram.gl.context);
+    // Present frames at the display's refresh rate if it can, the game ticks don't depend on it
+    tangram.vsync = SDL_GL_SetSwapInterval(1) == 0;
     if (gladLoadGL((GLADloadfunc)SDL_GL_GetProcAddress) <= 0)
     {
         fprintf(stderr, "Failed to create GL context: %s\n", SDL_GetError());
@@ -839,7 +388,7 @@ static int tangram_event_setup()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tangram.screen);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, tangram.screen.pixels);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     // Background
@@ -881,7 +430,26 @@ static int tangram_event_setup()
 
     init_genrand(SDL_GetTicks() + rand());
     init_clock(&tangram.clock);
-    init_game_state();
+    if (replay_path != NULL)
+    {
+        if (!open_replay(&replay, replay_path, game_state))
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open replay %s", replay_path);
+            return false;
+        }
+        reset_piece_frames();
+    }
+    else
+    {
+        journaling = open_journal(&journal, journal_path);
+        if (!journaling)
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Failed to open journal %s", journal_path);
+        if (!journaling || !restore_journal())
+            start_game();
+    }
+#ifdef GAME_DEBUG
+    setup_allocations = game_allocations;
+#endif
 
     BASS_ChannelSetAttribute(tangram.music, BASS_ATTRIB_VOL, 0.7f);
     BASS_ChannelPlay(tangram.music, 1);
@@ -905,7 +473,7 @@ static void tangram_event_update()
                 tangram.running = false;
             break;
         case SDL_KEYUP:
-            tangram.pressed.keys[event.key.keysym.sym] = false;
+            tangram.pressed.keys[event.key.keysym.scancode] = false;
             break;
         case SDL_QUIT:
             tangram.running = false;
@@ -915,39 +483,60 @@ static void tangram_event_update()
         }
     }
 
-    int input_h = (int)key_is_down(SDLK_RIGHT) - (int)key_is_down(SDLK_LEFT);
-    game_state->dhf = input_h != 0 ? game_state->dhf + 1 : 0;
-
-    if (game_state->are == 0 || game_state->ticks > game_state->are + ARE_FRAMES && !game_state->piece->locked)
+    // The game runs at a fixed tick rate, as many ticks as real time has passed are simulated this frame.
+    // After a long stall only `max_ticks_per_frame` are caught up and the rest is dropped.
+    Uint64 tick_length = SDL_GetPerformanceFrequency() / tick_rate;
+    unsigned int ticks = 0;
+    while (tangram.clock.accumulator >= tick_length && ticks < max_ticks_per_frame)
     {
-        if (key_is_up(SDLK_DOWN) && (game_state->dhf == 1 || game_state->dhf >= game_state->das))
-            move_piece(game_state->piece, input_h, 0);
-        if (key_is_pressed(SDLK_z))
-            rotate_piece(game_state->piece, -1);
-        if (key_is_pressed(SDLK_x))
-            rotate_piece(game_state->piece, 1);
-        if (key_is_down_buffered(SDLK_DOWN) || (every_n_frames(game_state->ftr) && !game_state->piece->coll))
+        if (replay_path != NULL)
         {
-            if (!game_state->piece->coll)
-                move_piece(game_state->piece, 0, game_state->gravity);
-            else
-                lock_piece(game_state->piece);
+            // Fast forwarding plays several frames per tick, their sounds would only pile up
+            for (unsigned int f = 0; f < replay_speed && step_replay(&replay, game_state); f++)
+            {
+                for (unsigned int i = 0; replay_speed == 1 && i < game_state->event_count; i++)
+                    handle_event(&game_state->events[i]);
+            }
         }
-
-        if (!game_state->piece->locked && game_state->piece->coll && game_state->ticks > game_state->lockticks + LOCK_DELAY)
-            lock_piece(game_state->piece);
+        else
+        {
+            unsigned int input = read_input();
+            step_game(game_state, input);
+            if (recording != NULL)
+                record_input(&recorder, input);
+            if (journaling)
+                log_input(&journal, game_state, input);
+            for (unsigned int i = 0; i < game_state->event_count; i++)
+                handle_event(&game_state->events[i]);
+        }
+        save_piece_frame();
+        tangram.clock.accumulator -= tick_length;
+        ticks++;
+    }
+    if (ticks == max_ticks_per_frame)
+        tangram.clock.accumulator %= tick_length;
+
+    if (replay_path != NULL)
+    {
+        // Left and right seek by the keyframe interval, up and down change the speed from 1x to 64x
+        long seek = replay.frame;
+        if (key_is_pressed(SDLK_RIGHT))
+            seek += KEYFRAME_INTERVAL;
+        if (key_is_pressed(SDLK_LEFT))
+            seek -= KEYFRAME_INTERVAL;
+        if (key_is_pressed(SDLK_r))
+            seek = 0;
+        if (seek != replay.frame)
+        {
+            seek_replay(&replay, game_state, seek);
+            reset_piece_frames();
+        }
+        if (key_is_pressed(SDLK_UP) && replay_speed < 64)
+            replay_speed *= 2;
+        if (key_is_pressed(SDLK_DOWN) && replay_speed > 1)
+            replay_speed /= 2;
     }
-    else if (
-        game_state->ticks > game_state->are + ARE_FRAMES &&
-        game_state->piece->locked &&
-        !game_state->game_over)
-    {
-        if (game_state->ftr > 4)
-            game_state->ftr = fps - game_state->level * 0.25;
-        game_state->piece = new_piece(-1);
-    }
-
-    if (key_is_pressed(SDLK_r) && game_state->game_over)
+    else if (key_is_pressed(SDLK_r) && game_state->game_over)
     {
         restart_game();
     }
@@ -960,8 +549,11 @@ static void tangram_event_update()
     SDL_GetWindowSizeInPixels(tangram.window, &ww, &wh);
     glUniform3f(glGetUniformLocation(tangram.gl.program, "iResolution"), (float)ww, (float)wh, 0.f);
 
-    char new_title[48];
-    sprintf(new_title, "%s | Level %d - Score: %d", title, game_state->level, game_state->score);
+    char new_title[96];
+    if (replay_path != NULL)
+        sprintf(new_title, "%s | Replay %ld/%ld at %ux | Level %d - Score: %d", title, replay.frame, replay.frames, replay_speed, game_state->level, game_state->score);
+    else
+        sprintf(new_title, "%s | Level %d - Score: %d", title, game_state->level, game_state->score);
     SDL_SetWindowTitle(tangram.window, new_title);
 }
 
@@ -977,12 +569,15 @@ static void tangram_event_render()
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
-    draw_clear(0);
-    draw_board();
+    // How far into the next tick the frame is drawn
+    float t = (float)tangram.clock.accumulator * tick_rate / SDL_GetPerformanceFrequency();
+    draw_clear(&tangram.screen, 0);
+    draw_board(&tangram.screen, tangram.textures.spritesheet, game_state,
+               &piece_frames[piece_frame], &piece_frames[piece_frame ^ 1], t < 1.0f ? t : 1.0f);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, tangram.gl.fg_texture_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, tangram.screen);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, tangram.screen.pixels);
 
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, tangram.gl.bg_texture_id);
@@ -996,6 +591,19 @@ static void tangram_event_render()
 
 static void tangram_event_exit()
 {
+    if (recording != NULL)
+    {
+        finish_recording(&recorder, game_state);
+        fclose(recording);
+    }
+    if (journaling)
+    {
+        // Quitting on purpose gives the game up
+        end_session(&journal);
+        close_journal(&journal);
+    }
+    if (replay_path != NULL)
+        close_replay(&replay);
     free_sounds();
     BASS_MusicFree(tangram.music);
     BASS_Free();
@@ -1011,15 +619,55 @@ static void tangram_event_exit()
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--ars") == 0)
+            game_rules.rotation = ROTATION_ARS;
+        else if (strcmp(argv[i], "--classic") == 0)
+            game_rules.rotation = ROTATION_CLASSIC;
+        else if (strcmp(argv[i], "--tgm1") == 0)
+            game_rules.randomizer = RANDOMIZER_TGM1;
+        else if (strcmp(argv[i], "--tgm2") == 0)
+            game_rules.randomizer = RANDOMIZER_TGM2;
+        else if (strcmp(argv[i], "--tgm3") == 0)
+            game_rules.randomizer = RANDOMIZER_TGM3;
+        else if (strcmp(argv[i], "--bag") == 0)
+            game_rules.randomizer = RANDOMIZER_BAG;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            game_rules.seed = strtoul(argv[++i], NULL, 0);
+            fixed_seed = true;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recording_path = argv[++i];
+        else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+            journal_path = argv[++i];
+    }
+
     tangram.running = tangram_event_setup();
 
     while (tangram.running)
     {
+#ifdef GAME_DEBUG
+        unsigned long allocations = game_allocation_count;
+#endif
         tangram_event_update();
         tangram_event_render();
+#ifdef GAME_DEBUG
+        // Neither playing nor drawing a frame allocates, only the recorder grows its block index once in a while
+        // and restarting with R while recording starts a new one
+        assert(game_allocation_count == allocations || recording != NULL);
+#endif
 
         // This limits the FPS so your CPU doesn't burst out in flames.
-        SDL_Delay(1000 / fps - tangram.clock.dt);
+        if (!tangram.vsync)
+        {
+            double elapsed = (double)(SDL_GetPerformanceCounter() - tangram.clock.now) / SDL_GetPerformanceFrequency();
+            if (elapsed * 1000.0 < 1000.0 / fps)
+                SDL_Delay((Uint32)(1000.0 / fps - elapsed * 1000.0));
+        }
     }
 
     tangram_event_exit();
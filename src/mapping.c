@@ -0,0 +1,123 @@
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapping.h"
+
+#ifdef _WIN32
+bool map_file(FileMapping *mapping, const char *path, size_t size, bool writable)
+{
+    memset(mapping, 0, sizeof(FileMapping));
+    mapping->writable = writable;
+    mapping->file = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapping->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    if (writable)
+    {
+        LARGE_INTEGER end;
+        end.QuadPart = size;
+        if (!SetFilePointerEx(mapping->file, end, NULL, FILE_BEGIN) || !SetEndOfFile(mapping->file))
+        {
+            CloseHandle(mapping->file);
+            return false;
+        }
+    }
+    else
+    {
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(mapping->file, &file_size);
+        size = file_size.QuadPart;
+    }
+    mapping->size = size;
+    if (size == 0)
+        return true;
+
+    mapping->mapping = CreateFileMappingA(mapping->file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+    if (mapping->mapping != NULL)
+        mapping->data = MapViewOfFile(mapping->mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    if (mapping->data == NULL)
+    {
+        unmap_file(mapping);
+        return false;
+    }
+    return true;
+}
+
+void flush_mapping(FileMapping *mapping)
+{
+    if (mapping->data != NULL && mapping->writable)
+        FlushViewOfFile(mapping->data, mapping->size);
+}
+
+void unmap_file(FileMapping *mapping)
+{
+    if (mapping->data != NULL)
+        UnmapViewOfFile(mapping->data);
+    if (mapping->mapping != NULL)
+        CloseHandle(mapping->mapping);
+    if (mapping->file != NULL && mapping->file != INVALID_HANDLE_VALUE)
+        CloseHandle(mapping->file);
+    memset(mapping, 0, sizeof(FileMapping));
+}
+#else
+bool map_file(FileMapping *mapping, const char *path, size_t size, bool writable)
+{
+    memset(mapping, 0, sizeof(FileMapping));
+    mapping->writable = writable;
+    mapping->file = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (mapping->file < 0)
+        return false;
+
+    if (writable)
+    {
+        if (ftruncate(mapping->file, size) != 0)
+        {
+            close(mapping->file);
+            return false;
+        }
+    }
+    else
+    {
+        struct stat info;
+        fstat(mapping->file, &info);
+        size = info.st_size;
+    }
+    mapping->size = size;
+    if (size == 0)
+        return true;
+
+    mapping->data = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, mapping->file, 0);
+    if (mapping->data == MAP_FAILED)
+    {
+        mapping->data = NULL;
+        unmap_file(mapping);
+        return false;
+    }
+    return true;
+}
+
+void flush_mapping(FileMapping *mapping)
+{
+    if (mapping->data != NULL && mapping->writable)
+        msync(mapping->data, mapping->size, MS_SYNC);
+}
+
+void unmap_file(FileMapping *mapping)
+{
+    if (mapping->data != NULL)
+        munmap(mapping->data, mapping->size);
+    if (mapping->file >= 0)
+        close(mapping->file);
+    memset(mapping, 0, sizeof(FileMapping));
+    mapping->file = -1;
+}
+#endif
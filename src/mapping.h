@@ -0,0 +1,29 @@
+#ifndef MAPPING_HEADER
+#define MAPPING_HEADER
+
+// Files mapped straight into memory, so reading them is a memory sweep instead of a stream of reads.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct FileMapping
+{
+	void *data; // `NULL` for an empty file
+	size_t size;
+	bool writable;
+#ifdef _WIN32
+	void *file; // HANDLE of the file
+	void *mapping; // HANDLE of its mapping
+#else
+	int file;
+#endif
+} FileMapping;
+
+// Map a file into memory. Read only mappings map the whole file and fail if it doesn't exist.
+// Writable mappings create the file if needed and grow or shrink it to `size` bytes first, changes are written back to it.
+bool map_file(FileMapping *mapping, const char *path, size_t size, bool writable);
+// Write the changes made to a writable mapping back to its file now, instead of whenever the system gets to it.
+void flush_mapping(FileMapping *mapping);
+void unmap_file(FileMapping *mapping);
+
+#endif
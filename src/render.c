@@ -0,0 +1,277 @@
+#include <math.h>
+
+#include "render.h"
+
+void draw_clear(Canvas *canvas, unsigned int color)
+{
+    unsigned int *p = canvas->pixels;
+    unsigned int *end = canvas->pixels + canvas->width * canvas->height;
+    unsigned int c = RGB_TO_BGR(color);
+    while (p < end)
+        *p++ = c;
+}
+
+void draw_pixel(Canvas *canvas, int x, int y, unsigned int color)
+{
+    if (x >= 0 && x < canvas->width && y >= 0 && y < canvas->height)
+    {
+        unsigned int *pixel = &canvas->pixels[((canvas->height - 1 - y) * canvas->width) + x];
+        if ((color & 0xFF000000) != 0xFF000000)
+            *pixel = RGB_TO_BGR(color);
+    }
+}
+
+void draw_line(Canvas *canvas, Point from, Point to, unsigned int color)
+{
+    // Bresenham's line algorithm
+    float dx = fabs(to.x - from.x);
+    float dy = fabs(to.y - from.y);
+    float sx = from.x < to.x ? 1.0f : -1.0f;
+    float sy = from.y < to.y ? 1.0f : -1.0f;
+    float err = dx - dy;
+
+    for (int i = 0; i <= fmaxf(dx, dy); i++)
+    {
+        draw_pixel(canvas, (int)(from.x + 0.5f), (int)(from.y + 0.5f), color);
+        if (from.x == to.x && from.y == to.y)
+            break;
+        int e2 = 2.0f * err;
+        if (e2 > -dy)
+        {
+            err -= dy;
+            from.x += sx;
+        }
+        if (e2 < dx)
+        {
+            err += dx;
+            from.y += sy;
+        }
+    }
+}
+
+void draw_rectangle(Canvas *canvas, Point from, Point to, unsigned int color, bool outline)
+{
+    const Point A = (Point){from.x, from.y};
+    const Point B = (Point){to.x, from.y};
+    const Point C = (Point){to.x, to.y};
+    const Point D = (Point){from.x, to.y};
+    if (outline)
+    {
+        draw_line(canvas, A, B, color);
+        draw_line(canvas, B, C, color);
+        draw_line(canvas, C, D, color);
+        draw_line(canvas, D, A, color);
+    }
+    else
+    {
+        for (int rx = from.x; rx < to.x; rx++)
+            for (int ry = from.y; ry < to.y; ry++)
+                draw_pixel(canvas, rx, ry, color);
+    }
+}
+
+void draw_texture(Canvas *canvas, TangramTexture *texture, Point pos, Point uv, Point size, float scale, unsigned int blend)
+{
+    // the image will pretend to have 3 channels but all textures are loaded with 4
+    int channels = 4;
+
+    // Extract blend color channels
+    unsigned char blend_r = (blend >> 16) & 0xFF;
+    unsigned char blend_g = (blend >> 8) & 0xFF;
+    unsigned char blend_b = blend & 0xFF;
+    float factor = ((blend >> 24) & 0xFF) / 255.0f; // Extract alpha as a blend factor
+
+    // Every pixel drawn samples the texel it lands on when the texture is scaled
+    for (int tx = 0; tx < (int)(size.x * scale); tx++)
+        for (int ty = 0; ty < (int)(size.y * scale); ty++)
+        {
+            int dtx = (int)(uv.x + (float)tx / scale);
+            int dty = (int)(uv.y + (float)ty / scale);
+
+            int pixel = (dty * texture->w + dtx) * channels;
+            unsigned char r = texture->data[pixel];
+            unsigned char g = texture->data[pixel + 1];
+            unsigned char b = texture->data[pixel + 2];
+            unsigned char a = texture->data[pixel + 3];
+
+            // Apply blending to the color
+            r = (unsigned char)(r * (1.0f - factor) + blend_r * factor);
+            g = (unsigned char)(g * (1.0f - factor) + blend_g * factor);
+            b = (unsigned char)(b * (1.0f - factor) + blend_b * factor);
+
+            unsigned int color = 0;
+            color |= (r << 16);
+            color |= (g << 8);
+            color |= b;
+
+            draw_pixel(canvas, pos.x + tx, pos.y + ty, color);
+    }
+}
+
+void draw_board(Canvas *canvas, TangramTexture *spritesheet, GameState *game, const PieceFrame *now, const PieceFrame *last, float t)
+{
+    float X_OFFSET = floor(canvas->width * 0.5 - BOARD_WIDTH * CELL_SIZE * 0.5);
+    float Y_OFFSET = floor(canvas->height * 0.5 - BOARD_HEIGHT * CELL_SIZE * 0.5);
+    // Draw board pane
+    draw_rectangle(
+        canvas,
+        (Point){X_OFFSET, Y_OFFSET},
+        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
+        0, false);
+    // Draw piece
+    if (!game->piece.locked)
+    {
+        Piece *p = &game->piece;
+        const uint16_t *mask = piece_mask(game, p->type, p->rotation);
+        int ghost_y = p->y + drop_distance(game, p);
+
+        // Blend the piece between the last two ticks by how far into the next tick we are,
+        // unless it just spawned or rotated
+        float x = now->piece.x;
+        float y = now->y;
+        if (!last->piece.locked && last->piece.type == now->piece.type && last->piece.rotation == now->piece.rotation)
+        {
+            x = last->piece.x + (x - last->piece.x) * t;
+            y = last->y + (y - last->y) * t;
+        }
+
+        // The ghost goes first so the piece is drawn over it
+        for (int b = 0; b < 32; b++)
+        {
+            if (!(mask[b / 4 % 4] & (1 << (b % 4))))
+                continue;
+            bool ghost = b < 16;
+            float bx = (ghost ? p->x : x) + b % 4;
+            float by = (ghost ? ghost_y : y) + b / 4 % 4;
+
+            draw_texture(
+                canvas,
+                spritesheet,
+                (Point){X_OFFSET + bx * CELL_SIZE, Y_OFFSET + by * CELL_SIZE},
+                (Point){(float)p->type * tile_size, 0.0f},
+                (Point){tile_size, tile_size},
+                (float)CELL_SIZE / tile_size, ghost ? 0xB0000000 : 0xFFFFFF);
+        }
+    }
+    // Draw queue pane
+    draw_rectangle(
+        canvas,
+        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE + 32, Y_OFFSET},
+        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE + 128, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
+        0xFFFFFF, true);
+    // Draw piece queue
+    for (int q = 1; q < QUEUE_SIZE; q++)
+    {
+        Piece next = new_piece(game, game->queue[q]);
+        if (next.type == PIECE_NONE)
+            continue;
+        const uint16_t *mask = piece_mask(game, next.type, next.rotation);
+        for (int n = 0; n < 16; n++)
+        {
+            if (!(mask[n / 4] & (1 << (n % 4))))
+                continue;
+            // Previews keep the size of the spritesheet whatever the size of the board
+            int nx = next.x - BOARD_SPAWN_SHIFT + n % 4;
+            int ny = next.y + n / 4;
+
+            Point draw_position = (Point){
+                X_OFFSET + (BOARD_WIDTH * CELL_SIZE) + nx * tile_size,
+                Y_OFFSET + (q - 1) * tile_size * 4 + ny * tile_size + tile_size};
+
+            draw_texture(
+                canvas,
+                spritesheet,
+                draw_position,
+                (Point){(float)next.type * tile_size, 0.0f},
+                (Point){tile_size, tile_size},
+                1.0f, 0xFFFFFF);
+        }
+    }
+    // Draw board, the walls, ceiling and floor around the rows count as filled so no outlines are drawn against them
+    const uint16_t *rows = &ROW(game, 0);
+    for (int bx = 0; bx < BOARD_WIDTH; bx++)
+    {
+        for (int by = 0; by < BOARD_HEIGHT; by++)
+        {
+            unsigned char *piece = &game->board[by * BOARD_WIDTH + bx];
+            if (rows[by] & CELL_BIT(bx))
+            {
+                draw_texture(
+                    canvas,
+                    spritesheet,
+                    (Point){X_OFFSET + bx * CELL_SIZE, Y_OFFSET + by * CELL_SIZE},
+                    (Point){*piece * tile_size, 0.0f},
+                    (Point){tile_size, tile_size},
+                    (float)CELL_SIZE / tile_size, 0xE0000000);
+                bool top_free = !(rows[by - 1] & CELL_BIT(bx));
+                bool left_free = !(rows[by] & CELL_BIT(bx - 1));
+                bool right_free = !(rows[by] & CELL_BIT(bx + 1));
+                bool bottom_free = !(rows[by + 1] & CELL_BIT(bx));
+                if (top_free)
+                {
+                    draw_line(
+                        canvas,
+                        (Point){X_OFFSET + bx * CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE},
+                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE},
+                        0xFFFFFF);
+                }
+                if (left_free)
+                {
+                    draw_line(
+                        canvas,
+                        (Point){X_OFFSET + bx * CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE},
+                        (Point){X_OFFSET + bx * CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
+                        0xFFFFFF);
+                }
+                if (right_free)
+                {
+                    draw_line(
+                        canvas,
+                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE},
+                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
+                        0xFFFFFF);
+                }
+                if (bottom_free)
+                {
+                    draw_line(
+                        canvas,
+                        (Point){X_OFFSET + bx * CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
+                        (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE,
+                                Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
+                        0xFFFFFF);
+                }
+            }
+        }
+    }
+    // Flash the piece that just locked
+    if (game->piece.locked && timer_armed(game, TIMER_LOCK_FLASH))
+    {
+        Piece *p = &game->piece;
+        const uint16_t *mask = piece_mask(game, p->type, p->rotation);
+        for (int b = 0; b < 16; b++)
+        {
+            if (!(mask[b / 4] & (1 << (b % 4))))
+                continue;
+            int bx = p->x + b % 4;
+            int by = p->y + b / 4;
+            draw_rectangle(
+                canvas,
+                (Point){X_OFFSET + bx * CELL_SIZE, Y_OFFSET + by * CELL_SIZE},
+                (Point){X_OFFSET + bx * CELL_SIZE + CELL_SIZE, Y_OFFSET + by * CELL_SIZE + CELL_SIZE},
+                0xFFFFFF, false);
+        }
+    }
+    // Draw border stroke
+    draw_rectangle(
+        canvas,
+        (Point){X_OFFSET, Y_OFFSET},
+        (Point){X_OFFSET + BOARD_WIDTH * CELL_SIZE, Y_OFFSET + BOARD_HEIGHT * CELL_SIZE},
+        0xFFFFFF, true);
+}
@@ -0,0 +1,52 @@
+#ifndef RENDER_HEADER
+#define RENDER_HEADER
+
+// Tangram's software rasterizer. It draws into plain pixel buffers and needs no window or GL context,
+// so games can be drawn the same way on screen and off it.
+
+#include <stdbool.h>
+
+#include "game.h"
+
+#define RGB_TO_BGR(c) ((c & 0xFF) << 16) | (c & 0xFF00) | ((c & 0xFF0000) >> 16)
+
+static const unsigned int tile_size = 16; // size of a block in the spritesheet, blocks are scaled to `CELL_SIZE`
+
+typedef struct Point
+{
+    float x, y;
+} Point;
+
+typedef struct TangramTexture
+{
+    unsigned char *data;
+    int w;
+    int h;
+    int channels;
+} TangramTexture;
+
+// Pixels drawn to, bottom row first as GL expects them. Every pixel is `RGB_TO_BGR` of its color, so its bytes go red, green, blue.
+typedef struct Canvas
+{
+    unsigned int *pixels;
+    int width;
+    int height;
+} Canvas;
+
+void draw_clear(Canvas *canvas, unsigned int color);
+void draw_pixel(Canvas *canvas, int x, int y, unsigned int color);
+void draw_line(Canvas *canvas, Point from, Point to, unsigned int color);
+void draw_rectangle(Canvas *canvas, Point from, Point to, unsigned int color, bool outline);
+void draw_texture(Canvas *canvas, TangramTexture *texture, Point pos, Point uv, Point size, float scale, unsigned int blend);
+
+// The falling piece at the end of a tick.
+typedef struct PieceFrame
+{
+    Piece piece;
+    float y; // row of the piece counting how far it has fallen into the next one
+} PieceFrame;
+
+// Draw a game centered on the canvas, with its falling piece blended from `last` to `now` by `t` between 0 and 1.
+void draw_board(Canvas *canvas, TangramTexture *spritesheet, GameState *game, const PieceFrame *now, const PieceFrame *last, float t);
+
+#endif
@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+static const char REPLAY_MAGIC[4] = {'R', '9', '7', 'R'};
+
+static void write_u32(unsigned char *bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (value >> (i * 8)) & 0xFF;
+}
+
+static uint32_t read_u32(const unsigned char *bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)bytes[i] << (i * 8);
+    return value;
+}
+
+static void write_varint(FILE *file, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+static bool read_varint(FILE *file, uint32_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        int byte = fgetc(file);
+        if (byte == EOF)
+            return false;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void write_run(ReplayRecorder *recorder)
+{
+    if (recorder->run == 0)
+        return;
+    fputc(recorder->input, recorder->file);
+    write_varint(recorder->file, recorder->run);
+    recorder->run = 0;
+}
+
+bool start_recording(ReplayRecorder *recorder, FILE *file, GameRules rules, bool indexed)
+{
+    memset(recorder, 0, sizeof(ReplayRecorder));
+    recorder->file = file;
+    recorder->start = ftell(file);
+    recorder->indexed = indexed;
+
+    // Frames, hash, score and index are left at 0 until the recording is finished
+    unsigned char header[REPLAY_HEADER_SIZE] = {0};
+    memcpy(header, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    header[4] = REPLAY_VERSION;
+    header[5] = rules.rotation;
+    header[6] = BOARD_WIDTH;
+    header[7] = BOARD_HEIGHT;
+    write_u32(&header[8], rules.seed);
+    header[32] = rules.randomizer;
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+void record_input(ReplayRecorder *recorder, unsigned int input)
+{
+    input &= 0xFF;
+    if (recorder->indexed && recorder->frames % REPLAY_BLOCK_FRAMES == 0)
+    {
+        // Blocks can't continue a run from the block before them
+        write_run(recorder);
+        if (recorder->block_count == recorder->block_capacity)
+        {
+            recorder->block_capacity = recorder->block_capacity > 0 ? recorder->block_capacity * 2 : 64;
+            recorder->blocks = realloc(recorder->blocks, recorder->block_capacity * sizeof(uint32_t));
+        }
+        recorder->blocks[recorder->block_count++] = ftell(recorder->file) - recorder->start;
+    }
+    else if (input != recorder->input)
+        write_run(recorder);
+
+    recorder->input = input;
+    recorder->run++;
+    recorder->frames++;
+}
+
+bool finish_recording(ReplayRecorder *recorder, GameState *game)
+{
+    write_run(recorder);
+    fputc(0, recorder->file);
+    write_varint(recorder->file, 0);
+
+    uint32_t index = 0;
+    if (recorder->indexed)
+    {
+        index = ftell(recorder->file) - recorder->start;
+        unsigned char bytes[4];
+        write_u32(bytes, recorder->block_count);
+        fwrite(bytes, 1, sizeof(bytes), recorder->file);
+        for (uint32_t i = 0; i < recorder->block_count; i++)
+        {
+            write_u32(bytes, recorder->blocks[i]);
+            fwrite(bytes, 1, sizeof(bytes), recorder->file);
+        }
+    }
+
+    unsigned char header[20];
+    uint64_t hash = game_hash(game);
+    write_u32(&header[0], recorder->frames);
+    write_u32(&header[4], hash & 0xFFFFFFFF);
+    write_u32(&header[8], hash >> 32);
+    write_u32(&header[12], game->score);
+    write_u32(&header[16], index);
+    fseek(recorder->file, recorder->start + 12, SEEK_SET);
+    fwrite(header, 1, sizeof(header), recorder->file);
+    fseek(recorder->file, 0, SEEK_END);
+
+    free(recorder->blocks);
+    recorder->blocks = NULL;
+    return fflush(recorder->file) == 0 && !ferror(recorder->file);
+}
+
+bool read_replay_header(FILE *file, ReplayHeader *header)
+{
+    unsigned char bytes[REPLAY_HEADER_SIZE];
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+        return false;
+    if (memcmp(bytes, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 || bytes[4] != REPLAY_VERSION)
+        return false;
+    if (bytes[5] >= ROTATION_AMOUNT || bytes[6] != BOARD_WIDTH || bytes[7] != BOARD_HEIGHT || bytes[32] >= RANDOMIZER_AMOUNT)
+        return false;
+
+    memset(header, 0, sizeof(ReplayHeader));
+    header->rules.rotation = bytes[5];
+    header->rules.seed = read_u32(&bytes[8]);
+    header->rules.randomizer = bytes[32];
+    header->frames = read_u32(&bytes[12]);
+    header->hash = read_u32(&bytes[16]) | (uint64_t)read_u32(&bytes[20]) << 32;
+    header->score = read_u32(&bytes[24]);
+    header->index = read_u32(&bytes[28]);
+    return true;
+}
+
+bool start_replay(ReplayReader *reader, FILE *file)
+{
+    memset(reader, 0, sizeof(ReplayReader));
+    reader->file = file;
+    reader->start = ftell(file);
+    if (!read_replay_header(file, &reader->header))
+        return false;
+
+    if (reader->header.index != 0)
+    {
+        unsigned char bytes[4];
+        fseek(file, reader->start + reader->header.index, SEEK_SET);
+        if (fread(bytes, 1, sizeof(bytes), file) == sizeof(bytes))
+            reader->block_count = read_u32(bytes);
+        fseek(file, reader->start + REPLAY_HEADER_SIZE, SEEK_SET);
+    }
+    return true;
+}
+
+int next_input(ReplayReader *reader)
+{
+    if (reader->run == 0)
+    {
+        if (reader->ended)
+            return -1;
+        // A replay that was never finished just stops where its file does
+        int input = fgetc(reader->file);
+        if (input == EOF || !read_varint(reader->file, &reader->run) || reader->run == 0)
+        {
+            reader->run = 0;
+            reader->ended = true;
+            return -1;
+        }
+        reader->input = input;
+    }
+    reader->run--;
+    reader->frame++;
+    return reader->input;
+}
+
+void seek_input(ReplayReader *reader, uint32_t frame)
+{
+    uint32_t block = frame / REPLAY_BLOCK_FRAMES;
+    if (block >= reader->block_count)
+        block = reader->block_count - 1;
+
+    if (reader->block_count > 0 && (frame < reader->frame || block * REPLAY_BLOCK_FRAMES > reader->frame))
+    {
+        unsigned char bytes[4];
+        fseek(reader->file, reader->start + reader->header.index + 4 + block * 4, SEEK_SET);
+        if (fread(bytes, 1, sizeof(bytes), reader->file) == sizeof(bytes))
+        {
+            fseek(reader->file, reader->start + read_u32(bytes), SEEK_SET);
+            reader->frame = block * REPLAY_BLOCK_FRAMES;
+            reader->run = 0;
+            reader->ended = false;
+        }
+    }
+    else if (frame < reader->frame)
+    {
+        fseek(reader->file, reader->start + REPLAY_HEADER_SIZE, SEEK_SET);
+        reader->frame = 0;
+        reader->run = 0;
+        reader->ended = false;
+    }
+
+    // Whole runs are skipped at once
+    while (reader->frame < frame)
+    {
+        if (reader->run == 0 && next_input(reader) < 0)
+            break;
+        uint32_t skip = frame - reader->frame < reader->run ? frame - reader->frame : reader->run;
+        reader->run -= skip;
+        reader->frame += skip;
+    }
+}
+
+long play_replay(FILE *file, GameState *game, ReplayHeader *header)
+{
+    ReplayReader reader;
+    if (!start_replay(&reader, file))
+        return -1;
+
+    init_game_state(game, reader.header.rules);
+    int input;
+    while ((input = next_input(&reader)) >= 0)
+        step_game(game, input);
+    *header = reader.header;
+    return reader.frame;
+}
+
+// Sidecar keyframe file header: "R97K", `KEYFRAME_VERSION`, the size of a keyframe, the `ENGINE_VERSION` that took
+// them, then what the replay they were taken from was recorded with, so a sidecar left over from another engine
+// or another replay is taken again instead of restored from.
+static const char KEYFRAME_MAGIC[4] = {'R', '9', '7', 'K'};
+
+typedef struct KeyframeHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t keyframe_size;
+    uint32_t engine;
+    uint64_t hash;
+    uint32_t frames;
+    uint32_t seed;
+    uint32_t rotation;
+    uint32_t randomizer;
+    uint32_t score;
+    uint32_t unused;
+} KeyframeHeader;
+
+_Static_assert(sizeof(KeyframeHeader) == 48, "sidecar headers are compared whole, they can't have padding");
+
+// The header a sidecar of the replay being opened has to have.
+static KeyframeHeader keyframe_header(ReplayPlayer *player)
+{
+    ReplayHeader *replay = &player->reader.header;
+    KeyframeHeader header = {{0}, KEYFRAME_VERSION, sizeof(ReplayKeyframe), ENGINE_VERSION, replay->hash, player->frames,
+                             replay->rules.seed, replay->rules.rotation, replay->rules.randomizer, replay->score, 0};
+    memcpy(header.magic, KEYFRAME_MAGIC, sizeof(KEYFRAME_MAGIC));
+    return header;
+}
+
+static void take_keyframe(ReplayKeyframe *keyframe, GameState *game, long frame)
+{
+    // The padding is cleared too, so the same replay always gets the same sidecar
+    memset(keyframe, 0, sizeof(ReplayKeyframe));
+    keyframe->frame = frame;
+    save_game(game, &keyframe->snapshot);
+    memcpy(keyframe->colors, game->board, sizeof(keyframe->colors));
+}
+
+static bool load_keyframes(ReplayPlayer *player, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    KeyframeHeader header, expected = keyframe_header(player);
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(&header, &expected, sizeof(header)) == 0 &&
+                 fread(player->keyframes, sizeof(ReplayKeyframe), player->keyframe_count, file) == (size_t)player->keyframe_count;
+    fclose(file);
+    return valid;
+}
+
+static void save_keyframes(ReplayPlayer *player, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return;
+
+    KeyframeHeader header = keyframe_header(player);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(player->keyframes, sizeof(ReplayKeyframe), player->keyframe_count, file);
+    fclose(file);
+}
+
+bool open_replay(ReplayPlayer *player, const char *path, GameState *game)
+{
+    memset(player, 0, sizeof(ReplayPlayer));
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    if (!start_replay(&player->reader, file))
+    {
+        fclose(file);
+        return false;
+    }
+
+    // Replays that were never finished don't know their length, they are counted while taking keyframes
+    player->frames = player->reader.header.frames;
+    player->keyframe_count = player->frames / KEYFRAME_INTERVAL + 1;
+    player->keyframes = malloc(player->keyframe_count * sizeof(ReplayKeyframe));
+
+    char index_path[1024];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    init_game_state(game, player->reader.header.rules);
+    bool loaded = load_keyframes(player, index_path);
+    if (loaded && player->reader.header.frames != 0)
+    {
+        // In case `ENGINE_VERSION` wasn't bumped, an engine that plays differently than the one that took the
+        // keyframes is unlikely to end the game the same from the last one
+        seek_replay(player, game, player->frames);
+        loaded = game_hash(game) == player->reader.header.hash && game->score == player->reader.header.score;
+        if (!loaded)
+        {
+            init_game_state(game, player->reader.header.rules);
+            player->frame = 0;
+            seek_input(&player->reader, 0);
+        }
+    }
+    if (!loaded)
+    {
+        // Play the whole replay once, stopping to take a keyframe every interval
+        player->frames = 0;
+        player->keyframe_count = 0;
+        do
+        {
+            if (player->frame % KEYFRAME_INTERVAL == 0)
+            {
+                player->keyframes = realloc(player->keyframes, (player->keyframe_count + 1) * sizeof(ReplayKeyframe));
+                take_keyframe(&player->keyframes[player->keyframe_count++], game, player->frame);
+            }
+        } while (step_replay(player, game));
+        player->frames = player->frame;
+        save_keyframes(player, index_path);
+    }
+
+    seek_replay(player, game, 0);
+    return true;
+}
+
+bool step_replay(ReplayPlayer *player, GameState *game)
+{
+    int input = next_input(&player->reader);
+    if (input < 0)
+        return false;
+    step_game(game, input);
+    player->frame = player->reader.frame;
+    return true;
+}
+
+void seek_replay(ReplayPlayer *player, GameState *game, long frame)
+{
+    if (frame < 0)
+        frame = 0;
+    if (frame > player->frames)
+        frame = player->frames;
+
+    // Going forward within the same interval is faster from where the game already is
+    long k = frame / KEYFRAME_INTERVAL;
+    if (frame < player->frame || k > player->frame / KEYFRAME_INTERVAL)
+    {
+        ReplayKeyframe *keyframe = &player->keyframes[k];
+        restore_game(game, &keyframe->snapshot);
+        memcpy(game->board, keyframe->colors, sizeof(keyframe->colors));
+        player->frame = keyframe->frame;
+        seek_input(&player->reader, player->frame);
+    }
+    while (player->frame < frame)
+        step_replay(player, game);
+}
+
+void close_replay(ReplayPlayer *player)
+{
+    fclose(player->reader.file);
+    free(player->keyframes);
+    memset(player, 0, sizeof(ReplayPlayer));
+}
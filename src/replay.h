@@ -0,0 +1,138 @@
+#ifndef REPLAY_HEADER
+#define REPLAY_HEADER
+
+// Replays: the rules of a game followed by the `GameInput` bits of every frame it was played for.
+// Since the simulation is deterministic, playing them back through `step_game` rebuilds the exact same game.
+
+#include <stdio.h>
+
+#include "game.h"
+
+/*
+	Replay file layout, numbers are little endian:
+
+	0  "R97R"
+	4  REPLAY_VERSION
+	5  rotation system
+	6  board width
+	7  board height
+	8  seed, 4 bytes
+	12 frames recorded, 4 bytes
+	16 `game_hash` of the game once the last frame was played, 8 bytes
+	24 score of the game once the last frame was played, 4 bytes
+	28 offset of the block index, 4 bytes, 0 if the replay has none
+	32 randomizer
+	33 unused, 3 bytes
+	36 the inputs, as runs of frames that held the same `GameInput` bits:
+	   one byte of input bits followed by the length of the run as a varint, 7 bits per byte, lowest first,
+	   with the high bit set on every byte but the last. A run of 0 frames ends the inputs.
+
+	The frames, hash, score and index offset are only known once the game is over and are filled in by
+	`finish_recording`, a replay that was never finished has them at 0 but can still be played.
+
+	Offsets are counted from the start of the replay, which doesn't have to be the start of its file.
+	Replays can be recorded into and read from the middle of a bigger file, like an archive of many of them.
+
+	Replays recorded with an index start a new run every `REPLAY_BLOCK_FRAMES` frames, so each block of
+	frames can be read on its own. The index is the amount of blocks, 4 bytes, then the offset of each one.
+*/
+#define REPLAY_VERSION 4
+#define REPLAY_HEADER_SIZE 36
+#define REPLAY_BLOCK_FRAMES 600 // 10 seconds
+
+typedef struct ReplayHeader
+{
+	GameRules rules;
+	uint32_t frames;
+	uint64_t hash;
+	uint32_t score;
+	uint32_t index; // offset of the block index
+} ReplayHeader;
+
+typedef struct ReplayRecorder
+{
+	FILE *file;
+	long start; // offset of the replay in the file
+	unsigned char input; // input of the run being recorded
+	uint32_t run;        // frames in that run so far
+	uint32_t frames;
+	bool indexed;
+	uint32_t *blocks; // offset of every block started so far
+	uint32_t block_count;
+	uint32_t block_capacity; // doubled whenever `blocks` fills up, so recording rarely allocates
+} ReplayRecorder;
+
+typedef struct ReplayReader
+{
+	FILE *file;
+	long start; // offset of the replay in the file
+	ReplayHeader header;
+	unsigned char input; // input of the run being read
+	uint32_t run;        // frames left in that run
+	uint32_t frame;      // frames read so far
+	uint32_t block_count;
+	bool ended;
+} ReplayReader;
+
+// Write the header of a replay for a game started with `rules` where the file is, and get ready to record its inputs.
+// Passing `indexed` splits the inputs into blocks that `seek_input` can jump straight to.
+// Returns `false` if the file couldn't be written.
+bool start_recording(ReplayRecorder *recorder, FILE *file, GameRules rules, bool indexed);
+// Record the input of one frame, the run it belongs to is written once the input changes.
+void record_input(ReplayRecorder *recorder, unsigned int input);
+// Write the last run and the block index, then fill in the header with the frames recorded and the hash and score of `game`.
+// The file is left open. Returns `false` if the file couldn't be written.
+bool finish_recording(ReplayRecorder *recorder, GameState *game);
+// Read the header of a replay.
+// Returns `false` if the file isn't a replay or was recorded with another version or board.
+bool read_replay_header(FILE *file, ReplayHeader *header);
+// Read the header of a replay where the file is and get ready to read its inputs from the first frame.
+bool start_replay(ReplayReader *reader, FILE *file);
+// Returns the input of the next frame, or `-1` once every frame has been read.
+int next_input(ReplayReader *reader);
+// Get ready to read the inputs from `frame` on, going through the block index if the replay has one.
+void seek_input(ReplayReader *reader, uint32_t frame);
+// Start a game with the rules of a replay and play every recorded frame of it, with no window.
+// Returns the amount of frames played, or `-1` if the header couldn't be read.
+long play_replay(FILE *file, GameState *game, ReplayHeader *header);
+
+/*
+	Seeking through a replay restores the closest keyframe before the frame wanted and only simulates from there.
+
+	Keyframes are taken every `KEYFRAME_INTERVAL` frames the first time a replay is opened and kept in a
+	sidecar file next to it, named like the replay with `.idx` added, so later opens don't simulate it again.
+	They are copied straight out of memory and are only meant to be read back by the same engine. A sidecar
+	taken by another `ENGINE_VERSION`, or whose rules, length, score or final hash don't match the replay,
+	is taken again. So is one of a finished replay that doesn't end on its recorded hash when played from the
+	last keyframe.
+*/
+#define KEYFRAME_INTERVAL REPLAY_BLOCK_FRAMES // so restoring a keyframe lands on the start of a block
+#define KEYFRAME_VERSION 6
+
+typedef struct ReplayKeyframe
+{
+	uint32_t frame; // frames played before the keyframe was taken
+	GameSnapshot snapshot;
+	unsigned char colors[BOARD_WIDTH * BOARD_HEIGHT]; // `board` of the game, snapshots leave it out
+} ReplayKeyframe;
+
+typedef struct ReplayPlayer
+{
+	ReplayReader reader;
+	long frames;
+	ReplayKeyframe *keyframes; // one every `KEYFRAME_INTERVAL` frames, starting at frame 0
+	long keyframe_count;
+	long frame; // frames of the replay played so far
+} ReplayPlayer;
+
+// Open a replay and load its keyframes, then start it from its first frame in `game`.
+// Inputs are read from the file as the replay plays, so it stays open until `close_replay`.
+// Returns `false` if the replay couldn't be read.
+bool open_replay(ReplayPlayer *player, const char *path, GameState *game);
+// Play the next frame of the replay, returns `false` once every frame has been played.
+bool step_replay(ReplayPlayer *player, GameState *game);
+// Bring `game` to the state it had after `frame` frames of the replay.
+void seek_replay(ReplayPlayer *player, GameState *game, long frame);
+void close_replay(ReplayPlayer *player);
+
+#endif
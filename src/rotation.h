@@ -0,0 +1,373 @@
+#ifndef ROTATION_HEADER
+#define ROTATION_HEADER
+
+// Rotation systems, every one of them described only by data.
+// This header is included by game.h once the piece indices are known.
+
+#define MAX_KICKS 5
+
+/*
+	Piece mask indexing:
+
+	p = Piece type - 1 (7)
+	r = Rotation (4)
+	y = Row of the piece's 4x4 box (4)
+
+	Bit `n` of a row is set when column `n` of the box is filled,
+	shifting a row by `x + BOARD_WALL` lines it up with a row of the board.
+
+	Kick indexing:
+
+	i = 1 for the I piece, 0 for every other piece (2)
+	r = Rotation the piece is leaving (4)
+	d = 0 for clockwise, 1 for counter-clockwise (2)
+	n = Test number, the first one is always (0, 0) (MAX_KICKS)
+	(x, y) offset of the box, positive y is down (2)
+*/
+typedef struct RotationSystem
+{
+	uint16_t masks[7][4][4];
+	signed char bottom[7][4][4]; // lowest filled row of every column of the masks, `-1` for empty columns
+	signed char spawn[7][2]; // column and row of the box when a piece spawns
+	unsigned char kick_tests[2]; // amount of kicks tried by every piece but I, and by I
+	signed char kicks[2][4][2][MAX_KICKS][2];
+	unsigned char center_column; // one bit per `PieceIndex` that follows the center column rule when kicking
+} RotationSystem;
+
+enum RotationSystemIndex
+{
+	ROTATION_SRS,
+	ROTATION_ARS,
+	ROTATION_CLASSIC,
+	ROTATION_AMOUNT
+};
+typedef enum RotationSystemIndex RotationSystemIndex;
+
+static const RotationSystem ROTATION_SYSTEMS[ROTATION_AMOUNT] = {
+	// Super Rotation System, from the guideline games
+	[ROTATION_SRS] = {
+		.masks = {
+			{ // I
+				{0x0, 0xF, 0x0, 0x0},
+				{0x4, 0x4, 0x4, 0x4},
+				{0x0, 0x0, 0xF, 0x0},
+				{0x2, 0x2, 0x2, 0x2},
+			},
+			{ // J
+				{0x1, 0x7, 0x0, 0x0},
+				{0x6, 0x2, 0x2, 0x0},
+				{0x0, 0x7, 0x4, 0x0},
+				{0x2, 0x2, 0x3, 0x0},
+			},
+			{ // L
+				{0x4, 0x7, 0x0, 0x0},
+				{0x2, 0x2, 0x6, 0x0},
+				{0x0, 0x7, 0x1, 0x0},
+				{0x3, 0x2, 0x2, 0x0},
+			},
+			{ // O
+				{0x6, 0x6, 0x0, 0x0},
+				{0x6, 0x6, 0x0, 0x0},
+				{0x6, 0x6, 0x0, 0x0},
+				{0x6, 0x6, 0x0, 0x0},
+			},
+			{ // S
+				{0x6, 0x3, 0x0, 0x0},
+				{0x2, 0x6, 0x4, 0x0},
+				{0x0, 0x6, 0x3, 0x0},
+				{0x1, 0x3, 0x2, 0x0},
+			},
+			{ // Z
+				{0x3, 0x6, 0x0, 0x0},
+				{0x4, 0x6, 0x2, 0x0},
+				{0x0, 0x3, 0x6, 0x0},
+				{0x2, 0x3, 0x1, 0x0},
+			},
+			{ // T
+				{0x2, 0x7, 0x0, 0x0},
+				{0x2, 0x6, 0x2, 0x0},
+				{0x0, 0x7, 0x2, 0x0},
+				{0x2, 0x3, 0x2, 0x0},
+			},
+		},
+		.bottom = {
+			{ // I
+				{1, 1, 1, 1},
+				{-1, -1, 3, -1},
+				{2, 2, 2, 2},
+				{-1, 3, -1, -1},
+			},
+			{ // J
+				{1, 1, 1, -1},
+				{-1, 2, 0, -1},
+				{1, 1, 2, -1},
+				{2, 2, -1, -1},
+			},
+			{ // L
+				{1, 1, 1, -1},
+				{-1, 2, 2, -1},
+				{2, 1, 1, -1},
+				{0, 2, -1, -1},
+			},
+			{ // O
+				{-1, 1, 1, -1},
+				{-1, 1, 1, -1},
+				{-1, 1, 1, -1},
+				{-1, 1, 1, -1},
+			},
+			{ // S
+				{1, 1, 0, -1},
+				{-1, 1, 2, -1},
+				{2, 2, 1, -1},
+				{1, 2, -1, -1},
+			},
+			{ // Z
+				{0, 1, 1, -1},
+				{-1, 2, 1, -1},
+				{1, 2, 2, -1},
+				{2, 1, -1, -1},
+			},
+			{ // T
+				{1, 1, 1, -1},
+				{-1, 2, 1, -1},
+				{1, 2, 1, -1},
+				{1, 2, -1, -1},
+			},
+		},
+		.spawn = {{3, -1}, {3, 0}, {3, 0}, {3, 0}, {3, 0}, {3, 0}, {3, 0}},
+		.kick_tests = {5, 5},
+		.kicks = {
+			{ // J, L, O, S, Z, T
+				{{{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}}, {{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}}},
+				{{{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}}, {{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}}},
+				{{{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}}, {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}}},
+				{{{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}}, {{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}}},
+			},
+			{ // I
+				{{{0, 0}, {-2, 0}, {1, 0}, {-2, 1}, {1, -2}}, {{0, 0}, {-1, 0}, {2, 0}, {-1, -2}, {2, 1}}},
+				{{{0, 0}, {-1, 0}, {2, 0}, {-1, -2}, {2, 1}}, {{0, 0}, {2, 0}, {-1, 0}, {2, -1}, {-1, 2}}},
+				{{{0, 0}, {2, 0}, {-1, 0}, {2, -1}, {-1, 2}}, {{0, 0}, {1, 0}, {-2, 0}, {1, 2}, {-2, -1}}},
+				{{{0, 0}, {1, 0}, {-2, 0}, {1, 2}, {-2, -1}}, {{0, 0}, {-2, 0}, {1, 0}, {-2, 1}, {1, -2}}},
+			},
+		},
+		.center_column = 0,
+	},
+	// Arika Rotation System, from Tetris: The Grand Master
+	[ROTATION_ARS] = {
+		.masks = {
+			{ // I
+				{0x0, 0xF, 0x0, 0x0},
+				{0x4, 0x4, 0x4, 0x4},
+				{0x0, 0xF, 0x0, 0x0},
+				{0x4, 0x4, 0x4, 0x4},
+			},
+			{ // J
+				{0x0, 0x7, 0x4, 0x0},
+				{0x2, 0x2, 0x3, 0x0},
+				{0x0, 0x1, 0x7, 0x0},
+				{0x6, 0x2, 0x2, 0x0},
+			},
+			{ // L
+				{0x0, 0x7, 0x1, 0x0},
+				{0x3, 0x2, 0x2, 0x0},
+				{0x0, 0x4, 0x7, 0x0},
+				{0x2, 0x2, 0x6, 0x0},
+			},
+			{ // O
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+			},
+			{ // S
+				{0x0, 0x6, 0x3, 0x0},
+				{0x1, 0x3, 0x2, 0x0},
+				{0x0, 0x6, 0x3, 0x0},
+				{0x1, 0x3, 0x2, 0x0},
+			},
+			{ // Z
+				{0x0, 0x3, 0x6, 0x0},
+				{0x4, 0x6, 0x2, 0x0},
+				{0x0, 0x3, 0x6, 0x0},
+				{0x4, 0x6, 0x2, 0x0},
+			},
+			{ // T
+				{0x0, 0x7, 0x2, 0x0},
+				{0x2, 0x3, 0x2, 0x0},
+				{0x0, 0x2, 0x7, 0x0},
+				{0x2, 0x6, 0x2, 0x0},
+			},
+		},
+		.bottom = {
+			{ // I
+				{1, 1, 1, 1},
+				{-1, -1, 3, -1},
+				{1, 1, 1, 1},
+				{-1, -1, 3, -1},
+			},
+			{ // J
+				{1, 1, 2, -1},
+				{2, 2, -1, -1},
+				{2, 2, 2, -1},
+				{-1, 2, 0, -1},
+			},
+			{ // L
+				{2, 1, 1, -1},
+				{0, 2, -1, -1},
+				{2, 2, 2, -1},
+				{-1, 2, 2, -1},
+			},
+			{ // O
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+			},
+			{ // S
+				{2, 2, 1, -1},
+				{1, 2, -1, -1},
+				{2, 2, 1, -1},
+				{1, 2, -1, -1},
+			},
+			{ // Z
+				{1, 2, 2, -1},
+				{-1, 2, 1, -1},
+				{1, 2, 2, -1},
+				{-1, 2, 1, -1},
+			},
+			{ // T
+				{1, 2, 1, -1},
+				{1, 2, -1, -1},
+				{2, 2, 2, -1},
+				{-1, 2, 1, -1},
+			},
+		},
+		.spawn = {{3, -1}, {3, -1}, {3, -1}, {3, -1}, {3, -1}, {3, -1}, {3, -1}},
+		.kick_tests = {3, 1},
+		.kicks = {
+			{ // J, L, O, S, Z, T
+				{{{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}, {{0, 0}, {1, 0}, {-1, 0}, {0, 0}, {0, 0}}},
+			},
+			{ // I
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+			},
+		},
+		.center_column = 1 << PIECE_J | 1 << PIECE_L | 1 << PIECE_T,
+	},
+	// Nintendo Rotation System, from the NES game. There are no kicks at all
+	[ROTATION_CLASSIC] = {
+		.masks = {
+			{ // I
+				{0x0, 0x0, 0xF, 0x0},
+				{0x4, 0x4, 0x4, 0x4},
+				{0x0, 0x0, 0xF, 0x0},
+				{0x4, 0x4, 0x4, 0x4},
+			},
+			{ // J
+				{0x0, 0x7, 0x4, 0x0},
+				{0x2, 0x2, 0x3, 0x0},
+				{0x1, 0x7, 0x0, 0x0},
+				{0x6, 0x2, 0x2, 0x0},
+			},
+			{ // L
+				{0x0, 0x7, 0x1, 0x0},
+				{0x3, 0x2, 0x2, 0x0},
+				{0x4, 0x7, 0x0, 0x0},
+				{0x2, 0x2, 0x6, 0x0},
+			},
+			{ // O
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+				{0x0, 0x6, 0x6, 0x0},
+			},
+			{ // S
+				{0x0, 0x6, 0x3, 0x0},
+				{0x2, 0x6, 0x4, 0x0},
+				{0x0, 0x6, 0x3, 0x0},
+				{0x2, 0x6, 0x4, 0x0},
+			},
+			{ // Z
+				{0x0, 0x3, 0x6, 0x0},
+				{0x4, 0x6, 0x2, 0x0},
+				{0x0, 0x3, 0x6, 0x0},
+				{0x4, 0x6, 0x2, 0x0},
+			},
+			{ // T
+				{0x0, 0x7, 0x2, 0x0},
+				{0x2, 0x3, 0x2, 0x0},
+				{0x2, 0x7, 0x0, 0x0},
+				{0x2, 0x6, 0x2, 0x0},
+			},
+		},
+		.bottom = {
+			{ // I
+				{2, 2, 2, 2},
+				{-1, -1, 3, -1},
+				{2, 2, 2, 2},
+				{-1, -1, 3, -1},
+			},
+			{ // J
+				{1, 1, 2, -1},
+				{2, 2, -1, -1},
+				{1, 1, 1, -1},
+				{-1, 2, 0, -1},
+			},
+			{ // L
+				{2, 1, 1, -1},
+				{0, 2, -1, -1},
+				{1, 1, 1, -1},
+				{-1, 2, 2, -1},
+			},
+			{ // O
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+				{-1, 2, 2, -1},
+			},
+			{ // S
+				{2, 2, 1, -1},
+				{-1, 1, 2, -1},
+				{2, 2, 1, -1},
+				{-1, 1, 2, -1},
+			},
+			{ // Z
+				{1, 2, 2, -1},
+				{-1, 2, 1, -1},
+				{1, 2, 2, -1},
+				{-1, 2, 1, -1},
+			},
+			{ // T
+				{1, 2, 1, -1},
+				{1, 2, -1, -1},
+				{1, 1, 1, -1},
+				{-1, 2, 1, -1},
+			},
+		},
+		.spawn = {{3, -2}, {3, -1}, {3, -1}, {3, -1}, {3, -1}, {3, -1}, {3, -1}},
+		.kick_tests = {1, 1},
+		.kicks = {
+			{ // J, L, O, S, Z, T
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+			},
+			{ // I
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+				{{{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}, {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+			},
+		},
+		.center_column = 0,
+	},
+};
+
+#endif
@@ -19,10 +19,10 @@
 #include <stb/stb_image.h>
 
 #include "include/mt19937ar.h"
+#include "render.h"
 
 // Engine macros
 
-#define RGB_TO_BGR(c) ((c & 0xFF) << 16) | (c & 0xFF00) | ((c & 0xFF0000) >> 16)
 #define max(a,b) (((a) > (b)) ? (a) : (b))
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 #define sign(x) ((x < 0) ? -1 : 1)
@@ -31,7 +31,9 @@
 
 static const unsigned int width = 640;
 static const unsigned int height = 480;
-static const unsigned int fps = 60;
+static const unsigned int fps = 60; // frame rate cap when the display can't sync the swaps
+static const unsigned int tick_rate = 60; // game ticks simulated per second, whatever the frame rate
+static const unsigned int max_ticks_per_frame = 8; // ticks caught up at most in a single frame
 static const unsigned char *title = "Tetris";
 
 // Game loop events
@@ -52,6 +54,7 @@ typedef struct TangramClock
     Uint64 now;
     Uint64 last;
     double dt;
+    Uint64 accumulator; // performance counter time not simulated yet
 } TangramClock;
 
 void init_clock(TangramClock *clock);
@@ -59,11 +62,11 @@ void tick_clock(TangramClock *clock);
 
 typedef struct KeyboardMap
 {
-    int keys[322];
+    int keys[SDL_NUM_SCANCODES]; // indexed by scancode
 } KeyboardMap;
 
+bool key_is_down(SDL_KeyCode key);
 bool key_is_pressed(SDL_KeyCode key);
-bool key_is_down_buffered(SDL_KeyCode key);
 bool key_is_up(SDL_KeyCode key);
 
 typedef struct Vertex
@@ -73,21 +76,6 @@ typedef struct Vertex
   float tex_coord[2];
 } Vertex;
 
-typedef struct Point
-{
-	float x, y;
-} Point;
-
-
-
-typedef struct TangramTexture
-{
-    unsigned char *data;
-    int w;
-    int h;
-    int channels;
-} TangramTexture;
-
 TangramTexture *new_texture(const char *filename);
 void free_textures();
 
@@ -97,12 +85,6 @@ typedef struct TextureMap
     TangramTexture *spritesheet;
 } TextureMap;
 
-void draw_clear(unsigned int color);
-void draw_pixel(int x, int y, unsigned int color);
-void draw_line(Point from, Point to, unsigned int color);
-void draw_rectangle(Point from, Point to, unsigned int color, bool outline);
-void draw_texture(TangramTexture *texture, Point pos, Point uv, Point size, float scale, unsigned int blend);
-
 typedef struct TangramGL
 {
     SDL_GLContext context;
@@ -114,6 +96,15 @@ typedef struct TangramGL
 
 #define SOUND_AMOUNT 12
 
+enum SoundIndex
+{
+    SOUND_PIECECOLLIDE,
+    SOUND_DISAPPEAR = 8,
+    SOUND_FALL = 9,
+    SOUND_PIECELOCK = 10,
+    SOUND_IRS = 11,
+};
+
 HSTREAM new_sound(const char *filename);
 void init_sounds();
 void play_sound(int id, float volume);
@@ -129,11 +120,12 @@ struct TangramManager
     TangramClock clock;
     const unsigned char *keystate;
     KeyboardMap pressed;
-    unsigned int *screen;
+    Canvas screen;
     TextureMap textures;
     HMUSIC music;
     HSTREAM sfx[12];
     bool running;
+    bool vsync;
 } tangram;
 
 enum TangramResult
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "../game.h"
+#include "../replay.h"
+#include "../mapping.h"
+
+/*
+	An archive is every replay put into it one after the other in a single file, with an index next to it
+	named like the archive with `.index` added. Both are only ever appended to, a record a crash cut short
+	at the end of the index is left out when reading it and written over by the next one.
+
+	The index is a header of "R97I", `ARCHIVE_VERSION` and the size of a record, 4 bytes each plus 4 unused,
+	then one `ArchiveRecord` per replay copied straight out of memory. Queries map the index and sweep its
+	records without opening a single replay.
+*/
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_HEADER_SIZE 16
+
+static const char ARCHIVE_MAGIC[4] = {'R', '9', '7', 'I'};
+
+typedef struct ArchiveRecord
+{
+    uint64_t offset; // of the replay in the archive
+    uint64_t hash;   // `game_hash` of the game once the replay was played through
+    int64_t date;    // when the replay was last written to, in seconds since 1970
+    uint32_t seed;
+    uint16_t rotation;
+    uint16_t randomizer; // games dealt by different randomizers are different games even on the same seed
+    uint32_t score;
+    uint32_t level;
+    uint32_t frames;
+    uint32_t size; // bytes the replay takes in the archive
+} ArchiveRecord;
+
+_Static_assert(sizeof(ArchiveRecord) == 48, "records are read straight out of the index, so they can't have padding");
+
+static void index_path(char *path, size_t size, const char *archive)
+{
+    snprintf(path, size, "%s.index", archive);
+}
+
+static char *read_file(const char *path, long *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *bytes = malloc(*size > 0 ? *size : 1);
+    if (fread(bytes, 1, *size, file) != (size_t)*size)
+    {
+        free(bytes);
+        bytes = NULL;
+    }
+    fclose(file);
+    return bytes;
+}
+
+// Play a replay to fill in its record, then append it to the archive and its record to the index.
+// A finished replay that this build doesn't end the way it was recorded is left out, its record would be made up.
+static bool add_replay(FILE *archive, FILE *index, const char *path)
+{
+    ArchiveRecord record = {0};
+    FILE *file = fopen(path, "rb");
+    GameState game;
+    ReplayHeader header;
+    long frames = -1;
+    if (file != NULL)
+    {
+        frames = play_replay(file, &game, &header);
+        fclose(file);
+    }
+    if (frames < 0)
+    {
+        fprintf(stderr, "Skipped %s, it isn't a replay of this version and board\n", path);
+        return false;
+    }
+    if (header.frames != 0 && (frames != header.frames || game.score != header.score || game_hash(&game) != header.hash))
+    {
+        fprintf(stderr, "Skipped %s, it was recorded ending with score %u hash %016" PRIx64 " and this build doesn't replay it the same\n",
+                path, header.score, header.hash);
+        return false;
+    }
+
+    long size;
+    char *bytes = read_file(path, &size);
+    if (bytes == NULL)
+    {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return false;
+    }
+    struct stat info;
+    record.date = stat(path, &info) == 0 ? (int64_t)info.st_mtime : (int64_t)time(NULL);
+
+    fseek(archive, 0, SEEK_END);
+    record.offset = ftell(archive);
+    record.hash = game_hash(&game);
+    record.seed = header.rules.seed;
+    record.rotation = header.rules.rotation;
+    record.randomizer = header.rules.randomizer;
+    record.score = game.score;
+    record.level = game.level;
+    record.frames = frames;
+    record.size = size;
+
+    // The replay goes in first, so an index record never points past the end of the archive
+    bool written = fwrite(bytes, 1, size, archive) == (size_t)size && fflush(archive) == 0 &&
+                   fwrite(&record, sizeof(record), 1, index) == 1 && fflush(index) == 0;
+    free(bytes);
+    if (!written)
+        fprintf(stderr, "Failed to write %s into the archive\n", path);
+    return written;
+}
+
+// Open the index of an archive to append records to, right after the last whole record in it.
+// Returns `NULL` if the index can't be opened or belongs to another version.
+static FILE *open_index(const char *path)
+{
+    // Appending mode would write after whatever a crash left of a record, so the index is opened for updating
+    FILE *index = fopen(path, "r+b");
+    if (index == NULL)
+        index = fopen(path, "w+b");
+    if (index == NULL)
+        return NULL;
+
+    fseek(index, 0, SEEK_END);
+    long size = ftell(index);
+    unsigned char header[ARCHIVE_HEADER_SIZE] = {0};
+    uint32_t fields[2] = {ARCHIVE_VERSION, sizeof(ArchiveRecord)};
+    if (size < ARCHIVE_HEADER_SIZE)
+    {
+        memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        memcpy(header + 4, fields, sizeof(fields));
+        fseek(index, 0, SEEK_SET);
+        if (fwrite(header, 1, sizeof(header), index) != sizeof(header))
+        {
+            fclose(index);
+            return NULL;
+        }
+        size = ARCHIVE_HEADER_SIZE;
+    }
+    else
+    {
+        fseek(index, 0, SEEK_SET);
+        if (fread(header, 1, sizeof(header), index) != sizeof(header) ||
+            memcmp(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || memcmp(header + 4, fields, sizeof(fields)) != 0)
+        {
+            fclose(index);
+            return NULL;
+        }
+    }
+
+    // A record cut short by a crash while appending is written over by the next one
+    size_t count = (size - ARCHIVE_HEADER_SIZE) / sizeof(ArchiveRecord);
+    fseek(index, ARCHIVE_HEADER_SIZE + count * sizeof(ArchiveRecord), SEEK_SET);
+    return index;
+}
+
+static int add_replays(const char *archive_path, int count, char *paths[])
+{
+    char path[1024];
+    index_path(path, sizeof(path), archive_path);
+    FILE *archive = fopen(archive_path, "ab");
+    FILE *index = open_index(path);
+    if (archive == NULL || index == NULL)
+    {
+        fprintf(stderr, archive == NULL ? "Failed to open %s\n" : "Failed to open %s, or it's the index of another version\n",
+                archive == NULL ? archive_path : path);
+        if (archive != NULL)
+            fclose(archive);
+        if (index != NULL)
+            fclose(index);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!add_replay(archive, index, paths[i]))
+            failed++;
+    }
+    fclose(archive);
+    fclose(index);
+    printf("Added %d replays to %s\n", count - failed, archive_path);
+    return failed > 0 ? 2 : 0;
+}
+
+// Map the index of an archive, returns its records or `NULL` if it isn't an index this build can read.
+static const ArchiveRecord *map_index(FileMapping *mapping, const char *archive_path, size_t *count)
+{
+    char path[1024];
+    index_path(path, sizeof(path), archive_path);
+    if (!map_file(mapping, path, 0, false))
+        return NULL;
+
+    const unsigned char *header = mapping->data;
+    uint32_t fields[2] = {0};
+    if (mapping->size >= ARCHIVE_HEADER_SIZE)
+        memcpy(fields, header + 4, sizeof(fields));
+    if (mapping->size < ARCHIVE_HEADER_SIZE || memcmp(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 ||
+        fields[0] != ARCHIVE_VERSION || fields[1] != sizeof(ArchiveRecord))
+    {
+        unmap_file(mapping);
+        return NULL;
+    }
+
+    // A record cut short by a crash while appending is left out, see `open_index`
+    *count = (mapping->size - ARCHIVE_HEADER_SIZE) / sizeof(ArchiveRecord);
+    return (const ArchiveRecord *)(header + ARCHIVE_HEADER_SIZE);
+}
+
+static int compare_scores(const void *a, const void *b)
+{
+    const ArchiveRecord *x = a, *y = b;
+    if (x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    // Ties go to whoever got there first
+    return x->frames < y->frames ? -1 : x->frames > y->frames;
+}
+
+static int query_archive(const char *archive_path, int argc, char *argv[])
+{
+    bool by_seed = false;
+    uint32_t seed = 0, min_score = 0;
+    int randomizer = -1;
+    size_t top = 0;
+    for (int i = 0; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "seed") == 0)
+        {
+            by_seed = true;
+            seed = strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (strcmp(argv[i], "randomizer") == 0)
+            randomizer = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "score") == 0)
+            min_score = strtoul(argv[i + 1], NULL, 0);
+        else if (strcmp(argv[i], "top") == 0)
+            top = strtoul(argv[i + 1], NULL, 0);
+    }
+
+    FileMapping mapping;
+    size_t count;
+    const ArchiveRecord *records = map_index(&mapping, archive_path, &count);
+    if (records == NULL)
+    {
+        fprintf(stderr, "%s has no index this version can read\n", archive_path);
+        return 1;
+    }
+
+    ArchiveRecord *matches = malloc((count > 0 ? count : 1) * sizeof(ArchiveRecord));
+    size_t match_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((!by_seed || records[i].seed == seed) && (randomizer < 0 || records[i].randomizer == randomizer) &&
+            records[i].score >= min_score)
+            matches[match_count++] = records[i];
+    }
+    unmap_file(&mapping);
+
+    // Asking for the top games makes a leaderboard, otherwise games come in the order they were archived
+    if (top > 0)
+    {
+        qsort(matches, match_count, sizeof(ArchiveRecord), compare_scores);
+        if (match_count > top)
+            match_count = top;
+    }
+    printf("offset,size,seed,rotation,randomizer,score,level,frames,date,hash\n");
+    for (size_t i = 0; i < match_count; i++)
+    {
+        ArchiveRecord *record = &matches[i];
+        char date[32];
+        time_t seconds = record->date;
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&seconds));
+        printf("%" PRIu64 ",%u,%u,%u,%u,%u,%u,%u,%s,%016" PRIx64 "\n", record->offset, record->size, record->seed,
+               record->rotation, record->randomizer, record->score, record->level, record->frames, date, record->hash);
+    }
+    free(matches);
+    return 0;
+}
+
+static int extract_replay(const char *archive_path, uint64_t offset, const char *out_path)
+{
+    FileMapping mapping, archive;
+    size_t count;
+    const ArchiveRecord *records = map_index(&mapping, archive_path, &count);
+    if (records == NULL)
+    {
+        fprintf(stderr, "%s has no index this version can read\n", archive_path);
+        return 1;
+    }
+    if (!map_file(&archive, archive_path, 0, false))
+    {
+        fprintf(stderr, "Failed to read %s\n", archive_path);
+        unmap_file(&mapping);
+        return 1;
+    }
+
+    int result = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (records[i].offset != offset)
+            continue;
+        FILE *out = fopen(out_path, "wb");
+        if (out != NULL && records[i].offset + records[i].size <= archive.size &&
+            fwrite((const char *)archive.data + offset, 1, records[i].size, out) == records[i].size)
+            result = 0;
+        if (out != NULL)
+            fclose(out);
+        break;
+    }
+    if (result != 0)
+        fprintf(stderr, "No replay of %s starts at %" PRIu64 "\n", archive_path, offset);
+    unmap_file(&archive);
+    unmap_file(&mapping);
+    return result;
+}
+
+// Keeps replays in an archive with an index of how every game went, so leaderboards and searches never open a replay.
+int main(int argc, char *argv[])
+{
+    if (argc >= 4 && strcmp(argv[1], "add") == 0)
+        return add_replays(argv[2], argc - 3, &argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "query") == 0)
+        return query_archive(argv[2], argc - 3, &argv[3]);
+    if (argc >= 5 && strcmp(argv[1], "extract") == 0)
+        return extract_replay(argv[2], strtoull(argv[3], NULL, 0), argv[4]);
+
+    fprintf(stderr, "Usage: %s add <archive> <replay>...\n", argv[0]);
+    fprintf(stderr, "       %s query <archive> [seed <seed>] [randomizer <randomizer>] [score <minimum>] [top <amount>]\n", argv[0]);
+    fprintf(stderr, "       %s extract <archive> <offset> <replay>\n", argv[0]);
+    return 1;
+}
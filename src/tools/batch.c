@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "batch.h"
+
+static bool is_sidecar(const char *name)
+{
+    size_t length = strlen(name);
+    return length >= 4 && strcmp(name + length - 4, ".idx") == 0;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void add_path(char ***paths, int *count, const char *directory, const char *name)
+{
+    if (name[0] == '.' || is_sidecar(name))
+        return;
+    size_t length = strlen(directory) + strlen(name) + 2;
+    char *path = malloc(length);
+    snprintf(path, length, "%s/%s", directory, name);
+    *paths = realloc(*paths, (*count + 1) * sizeof(char *));
+    (*paths)[(*count)++] = path;
+}
+
+char **list_replays(const char *directory, int *count)
+{
+    char **paths = NULL;
+    *count = 0;
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s/*", directory);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find == INVALID_HANDLE_VALUE)
+        return NULL;
+    do
+    {
+        if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            add_path(&paths, count, directory, found.cFileName);
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+#else
+    DIR *dir = opendir(directory);
+    if (dir == NULL)
+        return NULL;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN)
+            add_path(&paths, count, directory, entry->d_name);
+    }
+    closedir(dir);
+#endif
+    // An empty directory still gets a list, so only a failure returns NULL
+    if (paths == NULL)
+        paths = malloc(sizeof(char *));
+    qsort(paths, *count, sizeof(char *), compare_paths);
+    return paths;
+}
+
+void free_replays(char **paths, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(paths[i]);
+    free(paths);
+}
+
+int default_threads(void)
+{
+    int cores = SDL_GetCPUCount();
+    return cores > 0 ? cores : 1;
+}
+
+typedef struct JobQueue
+{
+    SDL_atomic_t next; // index of the next job to hand out
+    int count;
+    void (*job)(int index, int worker, void *data);
+    void *data;
+} JobQueue;
+
+typedef struct Worker
+{
+    JobQueue *queue;
+    int index;
+} Worker;
+
+static int run_worker(void *data)
+{
+    Worker *worker = data;
+    JobQueue *queue = worker->queue;
+    int index;
+    while ((index = SDL_AtomicAdd(&queue->next, 1)) < queue->count)
+        queue->job(index, worker->index, queue->data);
+    return 0;
+}
+
+void run_jobs(int count, int threads, void (*job)(int index, int worker, void *data), void *data)
+{
+    JobQueue queue = {{0}, count, job, data};
+    if (threads > count)
+        threads = count;
+    if (threads <= 1)
+    {
+        Worker worker = {&queue, 0};
+        run_worker(&worker);
+        return;
+    }
+
+    SDL_Thread **handles = malloc(threads * sizeof(SDL_Thread *));
+    Worker *workers = malloc(threads * sizeof(Worker));
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i] = (Worker){&queue, i};
+        handles[i] = SDL_CreateThread(run_worker, "worker", &workers[i]);
+    }
+    // Jobs left by threads that couldn't be created are run by the first worker once the others are done
+    for (int i = 0; i < threads; i++)
+    {
+        if (handles[i] != NULL)
+            SDL_WaitThread(handles[i], NULL);
+    }
+    run_worker(&workers[0]);
+    free(handles);
+    free(workers);
+}
@@ -0,0 +1,20 @@
+#ifndef BATCH_HEADER
+#define BATCH_HEADER
+
+// Running the headless simulation over a whole directory of replays at once, shared by the tools that do.
+
+#include <stdbool.h>
+
+// Paths of every file in `directory` except keyframe sidecars, sorted by name so reports always come out in the same order.
+// Returns `NULL` if the directory couldn't be read.
+char **list_replays(const char *directory, int *count);
+void free_replays(char **paths, int count);
+
+// Threads to run jobs on when none are asked for: one per core.
+int default_threads(void);
+// Call `job` once for every index below `count`, spread across `threads` threads.
+// Jobs run in any order and at the same time as each other, so each one must only write to its own results,
+// or to results kept for the `worker` running it, which goes from 0 to `threads - 1`.
+void run_jobs(int count, int threads, void (*job)(int index, int worker, void *data), void *data);
+
+#endif
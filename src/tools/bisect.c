@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../game.h"
+#include "../replay.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Finds the first frame of a replay where two engines stop agreeing and prints the state of both there.
+// The other engine is either another build of this tool, run as a child process, or this build playing with another rotation system.
+//
+// Each engine gives a `Trace` of its game after every frame and the first frame they differ on is the divergence.
+// Nothing keeps two engines from agreeing again after they drift apart, so every frame is compared in order.
+// Another build plays the replay once in `--trace` mode and streams its traces, stopping once this one stops reading,
+// then once more in `--dump` mode up to the divergence to print the whole state of its game there.
+
+static const char PIECE_NAMES[] = " IJLOSZT";
+
+// Bump whenever `Trace` or what its values mean changes, `game_hash` included, so two builds never compare
+// traces they write differently. Everything else about the state is only printed, and can change freely.
+#define TRACE_VERSION 1
+
+// The values two engines are compared on every frame, read from the game rather than from a `GameSnapshot`
+// so they stay the same when the snapshot or the timers change.
+typedef struct Trace
+{
+    uint64_t hash; // `game_hash`, the board, piece, queue and randomizer
+    uint64_t ticks;
+    unsigned int level;
+    unsigned int score;
+    unsigned int gravity;
+    unsigned int fall;
+    int clear_y1, clear_y2;
+    bool game_over;
+} Trace;
+
+typedef struct Engine
+{
+    const char *program; // other build of this tool, `NULL` to play in this process
+    const char *path;
+    GameRules rules;
+    FILE *file; // the replay, or the traces the other build writes
+    ReplayReader reader;
+    GameState game;
+    long frames; // frames played so far
+} Engine;
+
+static Trace trace_game(GameState *game)
+{
+    return (Trace){game_hash(game), game->ticks, game->level, game->score, game->gravity, game->fall,
+                   game->clear_y1, game->clear_y2, game->game_over};
+}
+
+static void write_trace(FILE *out, const Trace *trace)
+{
+    fprintf(out, "%016" PRIx64 " %" PRIu64 " %u %u %u %u %d %d %d\n", trace->hash, trace->ticks, trace->level,
+            trace->score, trace->gravity, trace->fall, trace->clear_y1, trace->clear_y2, trace->game_over);
+}
+
+static bool read_trace(FILE *in, Trace *trace)
+{
+    int game_over;
+    if (fscanf(in, "%" SCNx64 " %" SCNu64 " %u %u %u %u %d %d %d", &trace->hash, &trace->ticks, &trace->level,
+               &trace->score, &trace->gravity, &trace->fall, &trace->clear_y1, &trace->clear_y2, &game_over) != 9)
+        return false;
+    trace->game_over = game_over;
+    return true;
+}
+
+static bool same_trace(const Trace *a, const Trace *b)
+{
+    return a->hash == b->hash && a->ticks == b->ticks && a->level == b->level && a->score == b->score &&
+           a->gravity == b->gravity && a->fall == b->fall && a->clear_y1 == b->clear_y1 &&
+           a->clear_y2 == b->clear_y2 && a->game_over == b->game_over;
+}
+
+static void print_game(FILE *out, GameState *game)
+{
+    GameSnapshot snapshot;
+    save_game(game, &snapshot);
+    fprintf(out, "ticks %" PRIu64 " level %u score %u gravity %u fall %u game over %d\n",
+            game->ticks, snapshot.level, snapshot.score, snapshot.gravity, snapshot.fall, snapshot.game_over);
+    fprintf(out, "piece %c rotation %u x %d y %d locked %d queue ",
+            PIECE_NAMES[snapshot.piece.type % 8], snapshot.piece.rotation, snapshot.piece.x, snapshot.piece.y, snapshot.piece.locked);
+    for (int i = 0; i < QUEUE_SIZE; i++)
+        fputc(PIECE_NAMES[snapshot.queue[i] % 8], out);
+    fprintf(out, " rng %08" PRIx32 "\n", snapshot.randomizer.rng);
+    fprintf(out, "input %02x pressed %02x shifting %d clear %d-%d timers",
+            snapshot.input, snapshot.pressed, snapshot.shifting, snapshot.clear_y1, snapshot.clear_y2);
+    for (int t = 0; t < TIMER_AMOUNT; t++)
+        fprintf(out, snapshot.timers & (1 << t) ? " %u" : " -", snapshot.timer_left[t]);
+    fprintf(out, "\nhash %016" PRIx64 "\n", game_hash(game));
+    for (int y = 0; y < BOARD_HEIGHT; y++)
+    {
+        for (int x = 0; x < BOARD_WIDTH; x++)
+            fputc(snapshot.rows[y] & CELL_BIT(x) ? '#' : '.', out);
+        fputc('\n', out);
+    }
+}
+
+// Open a replay to play in this process, on its own rules but for `rotation` if it isn't negative.
+static bool open_engine(Engine *engine, const char *path, int rotation)
+{
+    engine->path = path;
+    engine->file = fopen(path, "rb");
+    if (engine->file == NULL || !start_replay(&engine->reader, engine->file))
+        return false;
+    engine->rules = engine->reader.header.rules;
+    if (rotation >= 0)
+        engine->rules.rotation = rotation;
+    init_game_state(&engine->game, engine->rules);
+    engine->frames = -1;
+    return true;
+}
+
+static void close_engine(Engine *engine)
+{
+    if (engine->file == NULL)
+        return;
+    if (engine->program != NULL)
+        pclose(engine->file);
+    else
+        fclose(engine->file);
+    engine->file = NULL;
+}
+
+// Run the other build on the replay, with the rules of an engine already opened on it.
+static FILE *run_program(Engine *engine, const char *mode, long frame)
+{
+    char command[2048];
+#ifdef _WIN32
+    // cmd.exe strips the outer quotes of a command before running it
+    snprintf(command, sizeof(command), "\"\"%s\" %s \"%s\" %d %ld\"", engine->program, mode, engine->path, engine->rules.rotation, frame);
+#else
+    snprintf(command, sizeof(command), "\"%s\" %s \"%s\" %d %ld", engine->program, mode, engine->path, engine->rules.rotation, frame);
+#endif
+    FILE *out = popen(command, "r");
+    if (out == NULL)
+        fprintf(stderr, "Failed to run %s\n", engine->program);
+    return out;
+}
+
+// Start the other build tracing the replay, returns `false` if it doesn't write traces of this version.
+static bool start_program(Engine *engine, const char *program)
+{
+    fclose(engine->file);
+    engine->program = program;
+    engine->frames = -1;
+    engine->file = run_program(engine, "--trace", 0);
+    int version;
+    return engine->file != NULL && fscanf(engine->file, "trace %d", &version) == 1 && version == TRACE_VERSION;
+}
+
+// Get the trace of an engine after its next frame, the state it starts in the first time.
+// Returns false once the replay has no frames left.
+static bool next_trace(Engine *engine, Trace *trace)
+{
+    if (engine->program != NULL)
+    {
+        if (!read_trace(engine->file, trace))
+            return false;
+    }
+    else
+    {
+        int input;
+        if (engine->frames >= 0)
+        {
+            if ((input = next_input(&engine->reader)) < 0)
+                return false;
+            step_game(&engine->game, input);
+        }
+        *trace = trace_game(&engine->game);
+    }
+    engine->frames++;
+    return true;
+}
+
+// Print the whole state of an engine at the frame it was last traced at.
+static void dump_engine(Engine *engine)
+{
+    if (engine->program == NULL)
+    {
+        print_game(stdout, &engine->game);
+        return;
+    }
+    // The trace is of no use anymore, closing it stops the other build
+    close_engine(engine);
+    FILE *out = run_program(engine, "--dump", engine->frames);
+    if (out == NULL)
+        return;
+    int c;
+    while ((c = fgetc(out)) != EOF)
+        putchar(c);
+    pclose(out);
+}
+
+// What another build runs to answer this one: the replay, the rotation system to play with, then for `--dump`
+// the frame to print the game at. Tracing stops early if nothing reads the traces anymore.
+static int serve(char *argv[])
+{
+    Engine engine = {0};
+    if (!open_engine(&engine, argv[2], atoi(argv[3])))
+        return 1;
+    bool dump = strcmp(argv[1], "--dump") == 0;
+    long frame = atol(argv[4]);
+    if (!dump)
+        printf("trace %d\n", TRACE_VERSION);
+    Trace trace;
+    while ((dump ? engine.frames < frame : !ferror(stdout)) && next_trace(&engine, &trace))
+    {
+        if (!dump)
+            write_trace(stdout, &trace);
+    }
+    if (dump)
+        print_game(stdout, &engine.game);
+    close_engine(&engine);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 5 && (strcmp(argv[1], "--trace") == 0 || strcmp(argv[1], "--dump") == 0))
+        return serve(argv);
+    if (argc < 3 || (strcmp(argv[2], "--rotation") == 0 && argc < 4))
+    {
+        fprintf(stderr, "Usage: %s <replay> <other build of %s>\n", argv[0], argv[0]);
+        fprintf(stderr, "       %s <replay> --rotation <rotation system to compare with>\n", argv[0]);
+        return 1;
+    }
+
+    bool rotation = strcmp(argv[2], "--rotation") == 0;
+    if (rotation && (atoi(argv[3]) < 0 || atoi(argv[3]) >= ROTATION_AMOUNT))
+    {
+        fprintf(stderr, "Rotation systems go from 0 to %d\n", ROTATION_AMOUNT - 1);
+        return 1;
+    }
+    static Engine ours, theirs;
+    if (!open_engine(&ours, argv[1], -1) || !open_engine(&theirs, argv[1], rotation ? atoi(argv[3]) : -1))
+    {
+        fprintf(stderr, "%s is not a replay of this version and board\n", argv[1]);
+        return 1;
+    }
+    // The other build plays the replay in its own process
+    if (!rotation && !start_program(&theirs, argv[2]))
+    {
+        fprintf(stderr, "%s didn't play %s, or doesn't trace it like this build\n", argv[2], argv[1]);
+        close_engine(&ours);
+        close_engine(&theirs);
+        return 1;
+    }
+
+    Trace a, b;
+    bool more_a, more_b;
+    do
+    {
+        more_a = next_trace(&ours, &a);
+        more_b = next_trace(&theirs, &b);
+    } while (more_a && more_b && same_trace(&a, &b));
+
+    int result = 0;
+    if (!more_a && !more_b)
+        printf("Both engines agree on all %ld frames\n", ours.frames);
+    else if (!more_a || !more_b)
+    {
+        fprintf(stderr, "%s stopped after %ld frames, the other engine played on\n",
+                more_a ? "The other engine" : "This engine", more_a ? theirs.frames : ours.frames);
+        result = 1;
+    }
+    else
+    {
+        printf("First divergence after %ld frames\n\n", ours.frames);
+        printf("ours (%s):\n", argv[0]);
+        dump_engine(&ours);
+        if (rotation)
+            printf("\ntheirs (rotation system %d):\n", theirs.rules.rotation);
+        else
+            printf("\ntheirs (%s):\n", argv[2]);
+        fflush(stdout);
+        dump_engine(&theirs);
+        result = 2;
+    }
+
+    close_engine(&ours);
+    close_engine(&theirs);
+    return result;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "../game.h"
+#include "../replay.h"
+
+// Plays a replay with no window and prints how the game ended, so runs can be compared or timed.
+// Fails if the game doesn't end with the score and hash the replay was recorded with.
+// Passing a frame seeks to it through the keyframes of the replay and prints the game there instead.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <replay> [frame]\n", argv[0]);
+        return 1;
+    }
+
+    static GameState game;
+    long frames;
+    ReplayHeader header;
+    if (argc > 2)
+    {
+        ReplayPlayer player;
+        if (!open_replay(&player, argv[1], &game))
+        {
+            fprintf(stderr, "%s is not a replay of this version and board\n", argv[1]);
+            return 1;
+        }
+        seek_replay(&player, &game, strtol(argv[2], NULL, 0));
+        frames = player.frame;
+        close_replay(&player);
+    }
+    else
+    {
+        FILE *file = fopen(argv[1], "rb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Failed to open %s\n", argv[1]);
+            return 1;
+        }
+        frames = play_replay(file, &game, &header);
+        fclose(file);
+        if (frames < 0)
+        {
+            fprintf(stderr, "%s is not a replay of this version and board\n", argv[1]);
+            return 1;
+        }
+    }
+
+    printf("frames %ld level %u score %u game over %d hash %016" PRIx64 "\n",
+           frames, game.level, game.score, game.game_over, game_hash(&game));
+    if (argc == 2 && header.frames != 0 && (header.hash != game_hash(&game) || header.score != game.score))
+    {
+        fprintf(stderr, "%s was recorded ending with score %u hash %016" PRIx64 ", this build doesn't replay it the same\n",
+                argv[1], header.score, header.hash);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+#define STBI_NO_SIMD
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include "../game.h"
+#include "../replay.h"
+#include "../render.h"
+#include "batch.h"
+
+// Frames are drawn at the size of the game window.
+#define RENDER_WIDTH 640
+#define RENDER_HEIGHT 480
+// Frames a worker draws in a row before taking the next ones, it plays the replay forward between them.
+#define RENDER_CHUNK 8
+
+typedef enum RenderFormat
+{
+    FORMAT_PPM, // one image per frame
+    FORMAT_Y4M, // a single uncompressed video stream
+} RenderFormat;
+
+typedef struct RenderWorker
+{
+    ReplayPlayer player; // shares the keyframes of `RenderBatch.player` but reads the replay through its own file
+    GameState game;
+} RenderWorker;
+
+/*
+	Workers draw frames straight into a ring of slots and the encoder thread writes them out in order.
+	A worker only takes the slot of frame `f` once frame `f - slot_count` has been written, so the worker
+	drawing the frame the encoder waits for can always go ahead.
+*/
+typedef struct RenderBatch
+{
+    const char *path;
+    ReplayPlayer *player;
+    TangramTexture *spritesheet;
+    long first; // first frame drawn, counted in frames of the replay played before it
+    long count; // frames drawn
+    RenderWorker *workers;
+    unsigned int **slots;
+    long *slot_frames; // frame drawn into every slot, -1 while it is being drawn or was already written
+    int slot_count;
+    long written; // frames written by the encoder so far
+    SDL_mutex *lock;
+    SDL_cond *changed;
+    RenderFormat format;
+    const char *output;
+    FILE *stream; // output of `FORMAT_Y4M`
+    bool failed;
+} RenderBatch;
+
+static void draw_frame(RenderBatch *batch, RenderWorker *worker, long frame, unsigned int *pixels)
+{
+    seek_replay(&worker->player, &worker->game, batch->first + frame);
+    // Frames are a tick apart, so the piece is drawn where the tick left it
+    Piece *p = &worker->game.piece;
+    PieceFrame now = {*p, p->y + (p->coll ? 0.0f : worker->game.fall / 256.0f)};
+    Canvas canvas = {pixels, RENDER_WIDTH, RENDER_HEIGHT};
+    draw_clear(&canvas, 0);
+    draw_board(&canvas, batch->spritesheet, &worker->game, &now, &now, 1.0f);
+}
+
+static void draw_chunk(int chunk, int worker, void *data)
+{
+    RenderBatch *batch = data;
+    long first = (long)chunk * RENDER_CHUNK;
+    long last = first + RENDER_CHUNK < batch->count ? first + RENDER_CHUNK : batch->count;
+    for (long frame = first; frame < last; frame++)
+    {
+        int slot = frame % batch->slot_count;
+        SDL_LockMutex(batch->lock);
+        while (frame - batch->slot_count >= batch->written)
+            SDL_CondWait(batch->changed, batch->lock);
+        SDL_UnlockMutex(batch->lock);
+
+        draw_frame(batch, &batch->workers[worker], frame, batch->slots[slot]);
+
+        SDL_LockMutex(batch->lock);
+        batch->slot_frames[slot] = frame;
+        SDL_CondBroadcast(batch->changed);
+        SDL_UnlockMutex(batch->lock);
+    }
+}
+
+// Canvases keep the bottom row first, images want the top one first.
+static void write_ppm(RenderBatch *batch, long frame, const unsigned int *pixels)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%06ld.ppm", batch->output, batch->first + frame);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        batch->failed = true;
+        return;
+    }
+    static unsigned char row[RENDER_WIDTH * 3];
+    fprintf(file, "P6\n%d %d\n255\n", RENDER_WIDTH, RENDER_HEIGHT);
+    for (int y = RENDER_HEIGHT - 1; y >= 0; y--)
+    {
+        const unsigned char *bytes = (const unsigned char *)&pixels[y * RENDER_WIDTH];
+        for (int x = 0; x < RENDER_WIDTH; x++)
+            memcpy(&row[x * 3], &bytes[x * 4], 3);
+        fwrite(row, 1, sizeof(row), file);
+    }
+    if (fclose(file) != 0)
+        batch->failed = true;
+}
+
+// Full resolution 4:4:4 planes, converted with the BT.601 studio range coefficients.
+static void write_y4m(RenderBatch *batch, const unsigned int *pixels)
+{
+    static unsigned char planes[3][RENDER_WIDTH * RENDER_HEIGHT];
+    for (int y = 0; y < RENDER_HEIGHT; y++)
+    {
+        const unsigned char *bytes = (const unsigned char *)&pixels[(RENDER_HEIGHT - 1 - y) * RENDER_WIDTH];
+        for (int x = 0; x < RENDER_WIDTH; x++)
+        {
+            int r = bytes[x * 4], g = bytes[x * 4 + 1], b = bytes[x * 4 + 2];
+            int i = y * RENDER_WIDTH + x;
+            planes[0][i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            planes[1][i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            planes[2][i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+    fputs("FRAME\n", batch->stream);
+    if (fwrite(planes, 1, sizeof(planes), batch->stream) != sizeof(planes))
+        batch->failed = true;
+}
+
+// Writes every frame out in order as the workers finish them, so encoding never holds up drawing.
+static int encode_frames(void *data)
+{
+    RenderBatch *batch = data;
+    if (batch->format == FORMAT_Y4M)
+        fprintf(batch->stream, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", RENDER_WIDTH, RENDER_HEIGHT);
+
+    for (long frame = 0; frame < batch->count; frame++)
+    {
+        int slot = frame % batch->slot_count;
+        SDL_LockMutex(batch->lock);
+        while (batch->slot_frames[slot] != frame)
+            SDL_CondWait(batch->changed, batch->lock);
+        SDL_UnlockMutex(batch->lock);
+
+        if (batch->format == FORMAT_Y4M)
+            write_y4m(batch, batch->slots[slot]);
+        else
+            write_ppm(batch, frame, batch->slots[slot]);
+
+        SDL_LockMutex(batch->lock);
+        batch->slot_frames[slot] = -1;
+        batch->written = frame + 1;
+        SDL_CondBroadcast(batch->changed);
+        SDL_UnlockMutex(batch->lock);
+    }
+    return 0;
+}
+
+static bool load_spritesheet(TangramTexture *texture, const char *path)
+{
+    texture->data = stbi_load(path, &texture->w, &texture->h, &texture->channels, STBI_rgb_alpha);
+    return texture->data != NULL;
+}
+
+// Draws the frames of a replay through the same rasterizer as the game, on every core, without a window.
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <replay> <output> [first frame] [last frame] [threads]\n", argv[0]);
+        fprintf(stderr, "An output ending in .y4m, or - for the standard output, is written as a Y4M video.\n");
+        fprintf(stderr, "Any other output is the start of the name of a PPM image for every frame.\n");
+        return 1;
+    }
+
+    TangramTexture spritesheet;
+    if (!load_spritesheet(&spritesheet, "data/img/texturemap.png"))
+    {
+        fprintf(stderr, "Failed to load data/img/texturemap.png\n");
+        return 1;
+    }
+    static GameState game;
+    ReplayPlayer player;
+    if (!open_replay(&player, argv[1], &game))
+    {
+        fprintf(stderr, "%s is not a replay of this version and board\n", argv[1]);
+        return 1;
+    }
+
+    RenderBatch batch = {argv[1], &player, &spritesheet};
+    batch.first = argc > 3 ? atol(argv[3]) : 0;
+    long last = argc > 4 ? atol(argv[4]) : player.frames;
+    if (batch.first < 0)
+        batch.first = 0;
+    if (last > player.frames)
+        last = player.frames;
+    batch.count = last >= batch.first ? last - batch.first + 1 : 0;
+    int threads = argc > 5 && atoi(argv[5]) > 0 ? atoi(argv[5]) : default_threads();
+
+    size_t length = strlen(argv[2]);
+    batch.output = argv[2];
+    batch.format = strcmp(argv[2], "-") == 0 || (length >= 4 && strcmp(argv[2] + length - 4, ".y4m") == 0) ? FORMAT_Y4M : FORMAT_PPM;
+    if (batch.format == FORMAT_Y4M)
+    {
+        batch.stream = strcmp(argv[2], "-") == 0 ? stdout : fopen(argv[2], "wb");
+        if (batch.stream == NULL)
+        {
+            fprintf(stderr, "Failed to write %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    batch.workers = malloc(threads * sizeof(RenderWorker));
+    for (int i = 0; i < threads; i++)
+    {
+        RenderWorker *worker = &batch.workers[i];
+        worker->player = player;
+        // Every worker reads the replay through its own file
+        FILE *file = fopen(argv[1], "rb");
+        if (file == NULL || !start_replay(&worker->player.reader, file))
+        {
+            fprintf(stderr, "Failed to open %s\n", argv[1]);
+            if (file != NULL)
+                fclose(file);
+            return 1;
+        }
+        worker->player.frame = 0;
+        init_game_state(&worker->game, player.reader.header.rules);
+    }
+    batch.slot_count = (threads + 1) * RENDER_CHUNK;
+    batch.slots = malloc(batch.slot_count * sizeof(unsigned int *));
+    batch.slot_frames = malloc(batch.slot_count * sizeof(long));
+    for (int i = 0; i < batch.slot_count; i++)
+    {
+        batch.slots[i] = malloc(RENDER_WIDTH * RENDER_HEIGHT * sizeof(unsigned int));
+        batch.slot_frames[i] = -1;
+    }
+    batch.lock = SDL_CreateMutex();
+    batch.changed = SDL_CreateCond();
+
+    SDL_Thread *encoder = SDL_CreateThread(encode_frames, "encoder", &batch);
+    run_jobs((batch.count + RENDER_CHUNK - 1) / RENDER_CHUNK, threads, draw_chunk, &batch);
+    SDL_WaitThread(encoder, NULL);
+
+    if (batch.stream != NULL && batch.stream != stdout && fclose(batch.stream) != 0)
+        batch.failed = true;
+    if (batch.failed)
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+    else if (batch.format == FORMAT_PPM)
+        fprintf(stderr, "Drew %ld frames into %s%06ld.ppm to %s%06ld.ppm\n", batch.count, argv[2], batch.first, argv[2], last);
+    else
+        fprintf(stderr, "Drew %ld frames into %s\n", batch.count, argv[2]);
+
+    SDL_DestroyCond(batch.changed);
+    SDL_DestroyMutex(batch.lock);
+    for (int i = 0; i < batch.slot_count; i++)
+        free(batch.slots[i]);
+    free(batch.slots);
+    free(batch.slot_frames);
+    for (int i = 0; i < threads; i++)
+        fclose(batch.workers[i].player.reader.file);
+    free(batch.workers);
+    close_replay(&player);
+    stbi_image_free(spritesheet.data);
+    return batch.failed ? 1 : 0;
+}
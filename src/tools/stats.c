@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../game.h"
+#include "../replay.h"
+#include "batch.h"
+
+// Levels are grouped in sections of 100 like the grades of TGM, the last section takes every level past it.
+#define STAT_SECTIONS 10
+#define STAT_SECTION_LEVELS 100
+// Droughts are counted in pieces dealt between two of the same piece, the last bucket takes every longer one.
+#define STAT_DROUGHTS 32
+
+typedef struct Stats
+{
+    uint64_t games;
+    uint64_t skipped; // files that aren't replays this build can play
+    uint64_t frames;
+    uint64_t pieces;
+    uint64_t lines;
+    uint64_t section_frames[STAT_SECTIONS];
+    uint64_t section_pieces[STAT_SECTIONS];
+    uint64_t clears[5];                              // line clears by the lines cleared at once
+    uint64_t heights[BOARD_WIDTH][BOARD_HEIGHT + 1]; // height of every column, sampled whenever a piece locks
+    uint64_t droughts[7][STAT_DROUGHTS];             // by `PieceIndex` minus one
+    uint64_t game_overs[8];                          // by the `PieceIndex` that locked above the board, `PIECE_NONE` for games that were never lost
+} Stats;
+
+typedef struct StatsBatch
+{
+    char **paths;
+    Stats *partials; // one per worker, merged once every replay has been played
+} StatsBatch;
+
+static unsigned int section(unsigned int level)
+{
+    return level / STAT_SECTION_LEVELS < STAT_SECTIONS ? level / STAT_SECTION_LEVELS : STAT_SECTIONS - 1;
+}
+
+// Play a replay until its game is over and add what happened in it to the stats of the worker.
+static void add_replay(int index, int worker, void *data)
+{
+    StatsBatch *batch = data;
+    Stats *stats = &batch->partials[worker];
+    FILE *file = fopen(batch->paths[index], "rb");
+    ReplayReader reader;
+    if (file == NULL || !start_replay(&reader, file))
+    {
+        if (file != NULL)
+            fclose(file);
+        stats->skipped++;
+        return;
+    }
+
+    GameState game;
+    init_game_state(&game, reader.header.rules);
+    uint64_t pieces = 0;
+    uint64_t last_seen[7] = {0}; // pieces dealt when every piece was last dealt, plus one
+    // The first piece is dealt as the game starts, before any frame raises its spawn
+    if (game.piece.type != PIECE_NONE)
+        last_seen[game.piece.type - 1] = ++pieces;
+    int input;
+    while (!game.game_over && (input = next_input(&reader)) >= 0)
+    {
+        // Locking a piece can already raise the level, so both the frame and the piece go to the section it was played in
+        unsigned int played = section(game.level);
+        stats->section_frames[played]++;
+        step_game(&game, input);
+
+        unsigned int lines = 0;
+        for (unsigned int i = 0; i < game.event_count; i++)
+        {
+            GameEvent *event = &game.events[i];
+            switch (event->type)
+            {
+            case EVENT_PIECE_SPAWN:
+            {
+                unsigned int piece = game.piece.type - 1;
+                if (last_seen[piece] > 0)
+                {
+                    uint64_t drought = pieces - last_seen[piece];
+                    stats->droughts[piece][drought < STAT_DROUGHTS ? drought : STAT_DROUGHTS - 1]++;
+                }
+                last_seen[piece] = ++pieces;
+                break;
+            }
+            case EVENT_PIECE_LOCK:
+                stats->pieces++;
+                stats->section_pieces[played]++;
+                for (int x = 0; x < BOARD_WIDTH; x++)
+                    stats->heights[x][game.heights[x]]++;
+                break;
+            case EVENT_LINE_CLEAR:
+                lines++;
+                break;
+            case EVENT_GAME_OVER:
+                stats->game_overs[game.piece.type]++;
+                break;
+            default:
+                break;
+            }
+        }
+        if (lines > 0)
+        {
+            stats->lines += lines;
+            stats->clears[lines < 4 ? lines : 4]++;
+        }
+    }
+    if (!game.game_over)
+        stats->game_overs[PIECE_NONE]++;
+    stats->games++;
+    stats->frames += reader.frame;
+    fclose(file);
+}
+
+static void merge_stats(Stats *into, const Stats *from)
+{
+    // Every field is a count, so the stats add up as one flat array
+    uint64_t *a = (uint64_t *)into;
+    const uint64_t *b = (const uint64_t *)from;
+    for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); i++)
+        a[i] += b[i];
+}
+
+static void write_stats(FILE *out, const Stats *stats)
+{
+    static const char PIECE_NAMES[] = " IJLOSZT";
+    fprintf(out, "statistic,key,subkey,value\n");
+    fprintf(out, "games,,,%" PRIu64 "\n", stats->games);
+    fprintf(out, "skipped,,,%" PRIu64 "\n", stats->skipped);
+    fprintf(out, "frames,,,%" PRIu64 "\n", stats->frames);
+    fprintf(out, "pieces,,,%" PRIu64 "\n", stats->pieces);
+    fprintf(out, "lines,,,%" PRIu64 "\n", stats->lines);
+    fprintf(out, "pieces_per_second,,,%.3f\n", stats->frames > 0 ? stats->pieces * 60.0 / stats->frames : 0.0);
+    for (int s = 0; s < STAT_SECTIONS; s++)
+    {
+        fprintf(out, "section_frames,%d,,%" PRIu64 "\n", s * STAT_SECTION_LEVELS, stats->section_frames[s]);
+        fprintf(out, "section_pieces_per_second,%d,,%.3f\n", s * STAT_SECTION_LEVELS,
+                stats->section_frames[s] > 0 ? stats->section_pieces[s] * 60.0 / stats->section_frames[s] : 0.0);
+    }
+    for (int lines = 1; lines <= 4; lines++)
+        fprintf(out, "clears,%d,,%" PRIu64 "\n", lines, stats->clears[lines]);
+    for (int x = 0; x < BOARD_WIDTH; x++)
+    {
+        for (int h = 0; h <= BOARD_HEIGHT; h++)
+            fprintf(out, "height,%d,%d,%" PRIu64 "\n", x, h, stats->heights[x][h]);
+    }
+    for (int p = 0; p < 7; p++)
+    {
+        for (int d = 0; d < STAT_DROUGHTS; d++)
+            fprintf(out, "drought,%c,%d,%" PRIu64 "\n", PIECE_NAMES[p + 1], d, stats->droughts[p][d]);
+    }
+    fprintf(out, "game_over,none,,%" PRIu64 "\n", stats->game_overs[PIECE_NONE]);
+    for (int p = PIECE_I; p <= PIECE_T; p++)
+        fprintf(out, "game_over,%c,,%" PRIu64 "\n", PIECE_NAMES[p], stats->game_overs[p]);
+}
+
+// Plays every replay in a directory on all cores and writes statistics about all of them as CSV.
+// Every statistic is a row of `statistic,key,subkey,value`, so the file loads straight into a spreadsheet or a dataframe.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <directory> [threads] [output.csv]\n", argv[0]);
+        return 1;
+    }
+
+    int count;
+    char **paths = list_replays(argv[1], &count);
+    if (paths == NULL)
+    {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    int threads = argc > 2 && atoi(argv[2]) > 0 ? atoi(argv[2]) : default_threads();
+    FILE *out = argc > 3 ? fopen(argv[3], "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failed to write %s\n", argv[3]);
+        return 1;
+    }
+
+    StatsBatch batch = {paths, calloc(threads, sizeof(Stats))};
+    run_jobs(count, threads, add_replay, &batch);
+    for (int i = 1; i < threads; i++)
+        merge_stats(&batch.partials[0], &batch.partials[i]);
+    write_stats(out, &batch.partials[0]);
+
+    if (out != stdout)
+        fclose(out);
+    free(batch.partials);
+    free_replays(paths, count);
+    return 0;
+}
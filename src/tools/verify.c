@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "../game.h"
+#include "../replay.h"
+#include "batch.h"
+
+typedef enum VerifyResult
+{
+    VERIFY_MATCH,
+    VERIFY_MISMATCH,
+    VERIFY_UNFINISHED, // never finished, so there's nothing to compare the game with
+    VERIFY_SKIPPED,    // not a replay this build can play
+} VerifyResult;
+
+typedef struct Verification
+{
+    VerifyResult result;
+    ReplayHeader header;
+    long frames;
+    unsigned int score;
+    uint64_t hash;
+} Verification;
+
+typedef struct VerifyBatch
+{
+    char **paths;
+    Verification *verifications;
+} VerifyBatch;
+
+// Every thread plays its replays in its own game, the simulation keeps no state outside of it.
+static void verify_replay(int index, int worker, void *data)
+{
+    VerifyBatch *batch = data;
+    Verification *verification = &batch->verifications[index];
+    verification->result = VERIFY_SKIPPED;
+
+    FILE *file = fopen(batch->paths[index], "rb");
+    if (file == NULL)
+        return;
+    GameState game;
+    verification->frames = play_replay(file, &game, &verification->header);
+    fclose(file);
+    if (verification->frames < 0)
+        return;
+
+    verification->score = game.score;
+    verification->hash = game_hash(&game);
+    if (verification->header.frames == 0)
+        verification->result = VERIFY_UNFINISHED;
+    else if (verification->frames != verification->header.frames ||
+             verification->score != verification->header.score ||
+             verification->hash != verification->header.hash)
+        verification->result = VERIFY_MISMATCH;
+    else
+        verification->result = VERIFY_MATCH;
+}
+
+// Plays every replay in a directory on all cores and reports the ones that don't end the way they were recorded.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <directory> [threads]\n", argv[0]);
+        return 1;
+    }
+
+    int count;
+    char **paths = list_replays(argv[1], &count);
+    if (paths == NULL)
+    {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return 1;
+    }
+    int threads = argc > 2 ? atoi(argv[2]) : default_threads();
+
+    VerifyBatch batch = {paths, calloc(count > 0 ? count : 1, sizeof(Verification))};
+    run_jobs(count, threads, verify_replay, &batch);
+
+    // Reported in the order of the files rather than as they finish, so runs can be diffed
+    int totals[VERIFY_SKIPPED + 1] = {0};
+    for (int i = 0; i < count; i++)
+    {
+        Verification *verification = &batch.verifications[i];
+        totals[verification->result]++;
+        if (verification->result == VERIFY_MISMATCH)
+            printf("mismatch %s: frames %ld score %u hash %016" PRIx64 ", recorded frames %u score %u hash %016" PRIx64 "\n",
+                   paths[i], verification->frames, verification->score, verification->hash,
+                   verification->header.frames, verification->header.score, verification->header.hash);
+        else if (verification->result == VERIFY_SKIPPED)
+            printf("skipped %s: not a replay of this version and board\n", paths[i]);
+    }
+    printf("%d replays: %d match, %d mismatch, %d unfinished, %d skipped\n",
+           count, totals[VERIFY_MATCH], totals[VERIFY_MISMATCH], totals[VERIFY_UNFINISHED], totals[VERIFY_SKIPPED]);
+
+    free(batch.verifications);
+    free_replays(paths, count);
+    return totals[VERIFY_MISMATCH] > 0 ? 2 : 0;
+}